@@ -2,7 +2,9 @@
  * @file passage_pathing.cpp
  * @author your name (you@domain.com)
  * @brief 
- * Compilation command : g++ -std=c++17 ./passage_pathing.cpp
+ * Compilation command : g++ -std=c++17 -O2 -pthread ./passage_pathing.cpp
+ * Usage: a.out input.txt [threads]
+ *        a.out --bench
  * Compiled with gcc 9.4.0
  * Problem statement : https://adventofcode.com/2021/day/12 
  * 
@@ -16,7 +18,22 @@
 #include <string>
 #include <iterator>
 #include <unordered_map>
-#include <unordered_set>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <map>
+#include <tuple>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <random>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <charconv>
+#include <system_error>
 
 using namespace std;
 
@@ -56,119 +73,280 @@ EdgeList ReadEdgesFromFile(const string& filename)
     return edges;
 }
 
+/**
+ * @brief 
+ * Cave system with every cave interned to a small integer id. Small caves
+ * additionally get a bit index so the set of visited small caves is a single
+ * uint64_t. Path counts depend only on (current cave, visited small caves,
+ * whether the one allowed revisit is still available), so they are memoised
+ * on exactly that state instead of enumerating every path.
+ */
 struct Graph
 {
     Graph() = delete;
     Graph(const EdgeList& edges)
     {
-        // Populate the adjacency matrix based on the given list of edges.
+        // Intern cave names and populate the adjacency lists based on the given list of edges.
+        auto ids = unordered_map<string, int>{};
+        const auto kIdOf = [&](const string& name)
+        {
+            if (auto pos = ids.find(name); pos != cend(ids)) { return pos->second; }
+            const auto kId = static_cast<int>(mnames.size());
+            ids.emplace(name, kId);
+            mnames.push_back(name);
+            madjList.emplace_back();
+            msmallBit.push_back(islower(name[0]) ? static_cast<int>(msmallCaveCount++) : -1);
+            return kId;
+        };
         for (const auto& [v1, v2] : edges)
         {
-            madjMat[v1].push_back(v2);
-            madjMat[v2].push_back(v1);
+            const auto kU = kIdOf(v1);
+            const auto kV = kIdOf(v2);
+            madjList[kU].push_back(kV);
+            madjList[kV].push_back(kU);
         }
+        mstart = ids.count("start") ? ids["start"] : -1;
+        mend   = ids.count("end")   ? ids["end"]   : -1;
+        if (msmallCaveCount > 64) { throw std::length_error{"at most 64 small caves are supported"}; }
     }
     void Print() const
     {
-        for (const auto& [vertex_u, vertices_connected_from_u] : madjMat)
+        for (auto u = size_t{0}; u < madjList.size(); ++u)
         {
-            cout << vertex_u << "->";
-            for (const auto vertex_v : vertices_connected_from_u) { cout << vertex_v << ","; }
+            cout << mnames[u] << "->";
+            for (const auto v : madjList[u]) { cout << mnames[v] << ","; }
             cout << endl;
         }
     }
 
-    size_t TotalPathsPart1()
+    /**
+     * @brief Total number of paths from start to end visiting each small cave at most once (Part 1).
+     */
+    size_t TotalPathsPart1(unsigned thread_count = 1) const { return TotalPaths(false, thread_count); }
+
+    /**
+     * @brief Total number of paths where a single small cave (other than start/end) may be visited twice (Part 2).
+     */
+    size_t TotalPathsPart2(unsigned thread_count = 1) const { return TotalPaths(true, thread_count); }
+
+    private:
+    struct PathState
     {
-        auto visisted_small_caves = unordered_set<string>{};
-        auto total_paths = size_t{ 0 };
-        TotalPathsPart1_REC("start", visisted_small_caves, total_paths);
-        return total_paths;
-    }
+        int cave;
+        uint64_t visited_small;
+        bool can_revisit;
+        bool operator<(const PathState& other) const
+        {
+            return std::tie(cave, visited_small, can_revisit) < std::tie(other.cave, other.visited_small, other.can_revisit);
+        }
+    };
+    struct PathStateHash
+    {
+        size_t operator()(const PathState& state) const
+        {
+            return std::hash<uint64_t>{}(state.visited_small * 0x9E3779B97F4A7C15ULL ^ (static_cast<uint64_t>(state.cave) << 1 | state.can_revisit));
+        }
+    };
+    struct PathStateEqual
+    {
+        bool operator()(const PathState& a, const PathState& b) const
+        {
+            return a.cave == b.cave && a.visited_small == b.visited_small && a.can_revisit == b.can_revisit;
+        }
+    };
 
     /**
-     * @brief Recursive function to calculate the total number of paths in the graph (Part 1).
-     * @param u The current vertex being visited.
-     * @param visited_small_vertices Set of visited small vertices.
-     * @param total_paths The total number of paths.
+     * @brief 
+     * Memo table shared by all threads, split into independently locked
+     * shards so threads rarely contend. A value may occasionally be computed
+     * by two threads at once; both compute the same count, so that is harmless.
      */
-    void TotalPathsPart1_REC(const string& u, unordered_set<string>& visited_small_verteices, size_t& total_paths)
+    class ShardedMemo
     {
-        if (u == "end") { ++total_paths; }
-        else
+        public:
+        std::optional<size_t> Find(const PathState& state)
         {
-            auto is_vertext_small = IsVertexSmall(u);
-            if (is_vertext_small && visited_small_verteices.find(u) != cend(visited_small_verteices)) { /*do nothing*/ }
-            else
-            {
-                if (is_vertext_small) { visited_small_verteices.insert(u); }
-                for (const auto& v : madjMat[u])
-                {
-                    TotalPathsPart1_REC(v, visited_small_verteices, total_paths);
-                }
-                if (is_vertext_small) { visited_small_verteices.erase(u); }
-            }
+            auto& shard = ShardOf(state);
+            auto lock   = std::lock_guard{ shard.mutex };
+            if (auto pos = shard.table.find(state); pos != cend(shard.table)) { return pos->second; }
+            return std::nullopt;
         }
-    }
+        void Insert(const PathState& state, size_t paths)
+        {
+            auto& shard = ShardOf(state);
+            auto lock   = std::lock_guard{ shard.mutex };
+            shard.table.emplace(state, paths);
+        }
+
+        private:
+        struct Shard
+        {
+            std::mutex mutex;
+            unordered_map<PathState, size_t, PathStateHash, PathStateEqual> table;
+        };
+        Shard& ShardOf(const PathState& state) { return shards[PathStateHash{}(state) % kShardCount]; }
+
+        static constexpr size_t kShardCount = 64;
+        array<Shard, kShardCount> shards;
+    };
 
     /**
-     * @brief Function to calculate the total number of paths in the graph (Part 2).
-     * @return The total number of paths.
+     * @brief 
+     * Expands the search from start level by level until there are enough
+     * independent subtrees for {thread_count} threads. Identical states
+     * reached through different prefixes are merged and carry the number of
+     * prefixes as a multiplicity. Each thread then takes the next unclaimed
+     * subtree from a shared counter (so idle threads pick up whatever work is
+     * left) and solves it against a sharded memo table shared by all threads,
+     * so overlapping subtrees are still only solved once; the results are summed.
      */
-    size_t TotalPathsPart2()
+    size_t TotalPaths(bool allow_revisit, unsigned thread_count) const
     {
-        auto total_paths        = size_t{0};
-        auto small_caves_counts = unordered_map<string, size_t>{};
-        TotalPathsPart2_REC("start", small_caves_counts, total_paths);
-        return total_paths;
+        if (mstart < 0 || mend < 0) { return 0; }
+        thread_count = std::max(1u, thread_count);
+        auto finished_paths = size_t{ 0 };
+        auto frontier       = map<PathState, size_t>{ { { mstart, SmallMask(mstart), allow_revisit }, 1 } };
+        for (auto depth = 0; thread_count > 1 && depth < kMaxSplitDepth && !frontier.empty() && frontier.size() < 4 * thread_count; ++depth)
+        {
+            auto next_frontier = map<PathState, size_t>{};
+            for (const auto& [state, multiplicity] : frontier)
+            {
+                ForEachNextState(state, [&, multiplicity = multiplicity](const PathState& next)
+                {
+                    if (next.cave == mend) { finished_paths += multiplicity; }
+                    else                   { next_frontier[next] += multiplicity; }
+                });
+            }
+            frontier = std::move(next_frontier);
+        }
+
+        const auto kTasks    = vector<pair<PathState, size_t>>(cbegin(frontier), cend(frontier));
+        auto next_task       = std::atomic<size_t>{ 0 };
+        auto partial_results = vector<size_t>(thread_count, 0);
+        auto memo            = std::make_unique<ShardedMemo>();
+        const auto kWorker   = [&](unsigned thread_idx)
+        {
+            for (auto task = next_task++; task < kTasks.size(); task = next_task++)
+            {
+                const auto& [state, multiplicity] = kTasks[task];
+                partial_results[thread_idx] += multiplicity * CountPaths_REC(*memo, state);
+            }
+        };
+        auto workers = vector<std::thread>{};
+        for (auto thread_idx = 1u; thread_idx < thread_count; ++thread_idx) { workers.emplace_back(kWorker, thread_idx); }
+        kWorker(0);
+        for (auto& worker : workers) { worker.join(); }
+        return std::accumulate(cbegin(partial_results), cend(partial_results), finished_paths);
     }
 
+    uint64_t SmallMask(int u) const { return msmallBit[u] < 0 ? 0 : (uint64_t{1} << msmallBit[u]); }
+
     /**
-     * @brief Function to check if the visiting criteria for small caves are met.
-     * @param small_caves_counts The counts of visits to small caves.
-     * @return True if the visiting criteria are met, otherwise false.
+     * @brief Calls func with every state reachable from @arg state in one step.
      */
-    bool IsSmallCaveVisitingCriteria(const unordered_map<string, size_t>& small_caves_counts)
+    template<typename Func>
+    void ForEachNextState(const PathState& state, Func func) const
     {
-        auto no_of_caves_visited_3_or_more_times = 0;
-        auto no_of_caves_visisted_2_times        = 0;
-        for (const auto& [key_ignore, value] : small_caves_counts)
+        for (const auto v : madjList[state.cave])
         {
-            no_of_caves_visited_3_or_more_times += (value >= 3);
-            no_of_caves_visisted_2_times        += (value == 2);
+            if (v == mstart) { continue; }
+            const auto kBit = SmallMask(v);
+            if ((state.visited_small & kBit) == 0)           { func(PathState{ v, state.visited_small | kBit, state.can_revisit }); }
+            else if (state.can_revisit && v != mend)         { func(PathState{ v, state.visited_small, false }); }
         }
-        return (no_of_caves_visited_3_or_more_times == 0) && (no_of_caves_visisted_2_times <= 1);
     }
 
     /**
-     * @brief Recursive function to calculate the total number of paths in the graph (Part 2).
-     * @param u The current vertex being visited.
-     * @param small_caves_counts The counts of visits to small caves.
-     * @param total_paths The total number of paths.
+     * @brief Number of paths from state.cave to end, given the small caves already on the path.
+     * @param memo Memo table shared by all threads.
+     * @param state The current cave (already included in visited_small if it is small),
+     *              the bit mask of small caves visited so far and whether a small cave may still be visited twice.
+     * NOTE: like the puzzle, this assumes no two big caves are directly connected.
      */
-    void TotalPathsPart2_REC(const string &u, unordered_map<string, size_t> &small_caves_counts, size_t &total_paths)
+    size_t CountPaths_REC(ShardedMemo& memo, const PathState& state) const
+    {
+        if (state.cave == mend) { return 1; }
+        if (auto cached = memo.Find(state); cached) { return *cached; }
+        auto total_paths = size_t{ 0 };
+        ForEachNextState(state, [&](const PathState& next) { total_paths += CountPaths_REC(memo, next); });
+        memo.Insert(state, total_paths);
+        return total_paths;
+    }
+
+    static constexpr int kMaxSplitDepth = 3;
+    vector<string>       mnames;
+    vector<vector<int>>  madjList;
+    vector<int>          msmallBit;//bit index of a small cave in the visited mask, -1 for big caves
+    size_t               msmallCaveCount{0};
+    int                  mstart{-1};
+    int                  mend{-1};
+};
+
+/**
+ * @brief 
+ * Random cave system with {small_caves} small caves (plus start and end) and
+ * {big_caves} big caves. Every small-small and small-big pair is connected
+ * with probability {density}; big caves are never connected to each other.
+ */
+EdgeList GenerateCaveSystem(int small_caves, int big_caves, double density)
+{
+    auto rng   = std::mt19937{ 42 };
+    auto coin  = std::bernoulli_distribution{ density };
+    auto small = vector<string>{ "start", "end" };
+    for (auto i = 0; i < small_caves; ++i) { small.push_back("s" + std::to_string(i)); }
+    auto edges = EdgeList{};
+    for (auto i = size_t{ 0 }; i < small.size(); ++i)
     {
-        if (IsSmallCaveVisitingCriteria(small_caves_counts) == false) {                return; }
-        if (u == "end")                                               { ++total_paths; return; }
-        auto is_small_vertex = IsVertexSmall(u);
-        if (is_small_vertex) { ++small_caves_counts[u]; }
-        for (const auto& v : madjMat[u])
+        for (auto j = i + 1; j < small.size(); ++j)
         {
-            if (v == "start") { continue; }
-            TotalPathsPart2_REC(v, small_caves_counts, total_paths);
+            if (coin(rng)) { edges.push_back({ small[i], small[j] }); }
+        }
+        for (auto b = 0; b < big_caves; ++b)
+        {
+            if (coin(rng)) { edges.push_back({ small[i], "B" + std::to_string(b) }); }
         }
-        if (is_small_vertex) { --small_caves_counts[u]; }
     }
+    return edges;
+}
 
-    bool IsVertexSmall(const string& vrtx)
+void RunBenchmark()
+{
+    const auto kGraph = Graph{ GenerateCaveSystem(15, 3, 0.5) };
+    auto baseline = 0.0;
+    for (auto threads : { 1u, 2u, 4u, 8u, 16u })
     {
-        return islower(vrtx[0]);//all_of(cbegin(vrtx), cend(vrtx), ::islower);
+        const auto kStart = std::chrono::steady_clock::now();
+        const auto kPaths = kGraph.TotalPathsPart2(threads);
+        const auto kMs    = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - kStart).count();
+        if (threads == 1) { baseline = kMs; }
+        cout << threads << " threads: " << kPaths << " paths in " << kMs << " ms (speedup " << baseline / kMs << "x)" << endl;
     }
-    unordered_map<string, vector<string>> madjMat;
-};
+}
 
 int main(int argc, const char* args[])
 {
+    if (argc < 2)
+    {
+        cout << "usage: " << args[0] << " <input file> [threads] | --bench" << endl;
+        return 1;
+    }
+    if (args[1] == string{ "--bench" })
+    {
+        RunBenchmark();
+        return 0;
+    }
+    auto threads = std::max(1u, std::thread::hardware_concurrency());
+    if (argc > 2)
+    {
+        const auto kArg      = string_view{ args[2] };
+        const auto [ptr, ec] = from_chars(kArg.data(), kArg.data() + kArg.size(), threads);
+        if (ec != errc{} || ptr != kArg.data() + kArg.size() || threads == 0)
+        {
+            cout << "invalid thread count: " << kArg << endl;
+            return 1;
+        }
+    }
+    const auto kThreads = threads;
     cout << "filename: " << args[1] << endl;
     auto edges = ReadEdgesFromFile(args[1]);
     // cout << endl << "Edges read from file: " << endl;
@@ -177,8 +355,8 @@ int main(int argc, const char* args[])
     // cout << endl << "Graph: " << endl;
     // graph.Print(); cout << endl;
 
-    auto total_paths_part1 = graph.TotalPathsPart1();
-    auto total_paths_part2 = graph.TotalPathsPart2();
+    auto total_paths_part1 = graph.TotalPathsPart1(kThreads);
+    auto total_paths_part2 = graph.TotalPathsPart2(kThreads);
     cout << "TOTAL PATHS (PART-1): " << total_paths_part1 << endl;
     cout << "TOTAL PATHS (PART-2): " << total_paths_part2 << endl;
     return 0;
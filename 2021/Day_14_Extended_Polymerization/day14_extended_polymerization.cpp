@@ -10,90 +10,674 @@
 #include <map>
 #include <iterator>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <stdexcept>
+#include <ostream>
+#include <istream>
+#include <cmath>
+#include <optional>
+#include <charconv>
+#include <system_error>
 
 using std::accumulate;
+using std::array;
 using std::cbegin;
 using std::cend;
 using std::cout;
 using std::ifstream;
-using std::map;
-using std::minmax_element;
 using std::pair;
 using std::string_view;
 using std::string;
-using std::unordered_map;
 using std::vector;
+using std::optional;
+using std::nullopt;
+
+constexpr auto kAlphabetSize = size_t{ 26 };
+constexpr auto kPairCount    = kAlphabetSize * kAlphabetSize;
+constexpr auto kNoPair       = kPairCount;     //sink slot for pairs without a rule
+constexpr auto kNoChar       = kAlphabetSize;  //sink slot for pairs without a rule
+
+using PairCounts = array<uint64_t, kPairCount + 1>;
+using CharCounts = array<uint64_t, kAlphabetSize + 1>;
+
+constexpr size_t PairIndex(char a, char b) { return static_cast<size_t>(a - 'A') * kAlphabetSize + static_cast<size_t>(b - 'A'); }
+
+/**
+ * @brief 
+ * Insertion rules as flat tables indexed by pair index a * 26 + b.
+ * For a rule AB -> C, left is AC, right is CB and inserted is C. A pair
+ * without a rule survives unchanged, so it maps to itself on the left and to
+ * the unused sink slots for the right pair and inserted character; that way
+ * the step loop needs no branch.
+ */
+struct PairRules
+{
+    array<uint16_t, kPairCount> left;
+    array<uint16_t, kPairCount> right;
+    array<uint8_t,  kPairCount> inserted;
+
+    PairRules()
+    {
+        for (auto idx = size_t{ 0 }; idx < kPairCount; ++idx)
+        {
+            left[idx]     = static_cast<uint16_t>(idx);
+            right[idx]    = static_cast<uint16_t>(kNoPair);
+            inserted[idx] = static_cast<uint8_t>(kNoChar);
+        }
+    }
+    void Add(char a, char b, char c)
+    {
+        const auto kIdx = PairIndex(a, b);
+        left[kIdx]      = static_cast<uint16_t>(PairIndex(a, c));
+        right[kIdx]     = static_cast<uint16_t>(PairIndex(c, b));
+        inserted[kIdx]  = static_cast<uint8_t>(c - 'A');
+    }
+};
 
 auto ReadInput(string_view filename)
 {
     auto fin          = ifstream{ filename.data() };
     auto template_str = string{};
-    auto rules_map    = map<pair<char, char>, char>{};
+    auto rules        = PairRules{};
     fin >> template_str;
     fin >> std::ws;
     
     auto str        = string{};
     while (getline(fin, str))
     {
-        //say rule is AB -> C
-        const auto kPairing    = pair{ str[0], str[1] }; //extract first two charcters i.e. AB from above string
-        const auto kMappedChar = str.back(); //extract last character i.e. C from above string
-        rules_map[kPairing]    = kMappedChar;
+        if (str.size() < 7) { continue; }
+        //say rule is AB -> C, extract first two charcters i.e. AB and the last character i.e. C
+        rules.Add(str[0], str[1], str.back());
+    }
+    return pair{ template_str, rules };
+}
+
+/**
+ * @brief 
+ * Advances the pair counts by one insertion step. Reads from {current},
+ * writes into {next} and adds the inserted characters to {char_counts}.
+ * Returns false if any count overflowed uint64_t; {next} and {char_counts}
+ * are then meaningless.
+ */
+bool PolymerStep(const PairRules &rules, const PairCounts &current, PairCounts &next, CharCounts &char_counts)
+{
+    next.fill(0);
+    auto overflow = false;
+    for (auto idx = size_t{ 0 }; idx < kPairCount; ++idx)
+    {
+        const auto kCount = current[idx];
+        overflow |= __builtin_add_overflow(next[rules.left[idx]], kCount, &next[rules.left[idx]]);
+        overflow |= __builtin_add_overflow(next[rules.right[idx]], kCount, &next[rules.right[idx]]);
+        overflow |= __builtin_add_overflow(char_counts[rules.inserted[idx]], kCount, &char_counts[rules.inserted[idx]]);
+    }
+    return !overflow;
+}
+
+uint64_t MaxMinDifference(const CharCounts &char_counts)
+{
+    auto max_count = uint64_t{ 0 };
+    auto min_count = std::numeric_limits<uint64_t>::max();
+    for (auto ch = size_t{ 0 }; ch < kAlphabetSize; ++ch)
+    {
+        if (char_counts[ch] == 0) { continue; }
+        max_count = std::max(max_count, char_counts[ch]);
+        min_count = std::min(min_count, char_counts[ch]);
     }
-    return pair{ template_str, rules_map };
+    return max_count - min_count;
 }
 
-size_t ApplyPolymerInsertionRules(string_view template_str, const map<pair<char, char>, char> &kRulesUmap, const int &n)
+/**
+ * @brief 
+ * Incremental polymer simulation. The character histogram of every step is
+ * produced lazily: asking for step k only runs the steps between the
+ * furthest step computed so far and k, and every histogram on the way is
+ * kept so earlier steps are answered from memory. Only the pair counts of
+ * the furthest step are kept.
+ * The furthest state can be saved as a checkpoint and loaded into a trace
+ * built from the same rules, which then resumes from that step; histograms
+ * of steps before the checkpoint are not available after resuming.
+ * Counts are uint64_t, so they are exact up to roughly 60 steps for the
+ * puzzle input. A step whose counts overflow is never produced: IsExactAt()
+ * returns false for it and HistogramAt() throws std::overflow_error; use
+ * PolymerMatrix beyond that.
+ */
+class PolymerTrace
 {
-    //Generate character count inital template
-    auto character_count_umap = unordered_map<char, size_t>{};
-    for (const auto &ch : template_str)
-    { 
-        ++character_count_umap[ch];
+    public:
+    PolymerTrace(string_view template_str, const PairRules &rules) : rules{ rules }
+    {
+        auto char_counts = CharCounts{};
+        for (const auto &ch : template_str) { ++char_counts[ch - 'A']; }
+        for (auto idx = size_t{ 1 }; idx < size(template_str); ++idx)
+        {
+            ++buffers[0][PairIndex(template_str[idx - 1], template_str[idx])];
+        }
+        histograms.push_back(char_counts);
     }
-    //Insert all adjacent pairs from template string into map
-    auto pairs_count_map = map<pair<char, char>, size_t>{};
-    for (auto idx = 0; idx < size(template_str) - 1 ;++idx)
+
+    size_t FirstStep()    const { return first_step; }
+    size_t FurthestStep() const { return first_step + histograms.size() - 1; }
+
+    /**
+     * @brief True if the histogram after {step} steps is available and exact.
+     * Computes the steps up to {step}, or up to the first step that overflows.
+     */
+    bool IsExactAt(size_t step) { return step >= first_step && Advance(step); }
+
+    /**
+     * @brief Character histogram after {step} steps (index ch - 'A'); step must be >= FirstStep().
+     * @throws std::overflow_error if the counts of {step} do not fit in uint64_t
+     */
+    const CharCounts &HistogramAt(size_t step)
     {
-        ++pairs_count_map[{template_str[idx], template_str[idx + 1]}];
+        if (step < first_step) { throw std::out_of_range{ "step precedes the loaded checkpoint" }; }
+        if (!Advance(step))    { throw std::overflow_error{ "polymer counts exceed 64 bits" }; }
+        return histograms[step - first_step];
     }
 
-    for (auto ii = 0; ii < n ;++ii)
+    uint64_t MaxMinDifferenceAt(size_t step) { return MaxMinDifference(HistogramAt(step)); }
+
+    /**
+     * @brief 
+     * Lazy view over the histograms of steps [first, last). Each histogram is
+     * computed only when the iterator reaches it.
+     */
+    class StepRange
     {
-        auto new_pairs_count_map = map<pair<char, char>, size_t>{};//For storing new pairs that are generated
-        for (auto &[current_pair, count] : pairs_count_map)
+        public:
+        class iterator
         {
-            if (count > 0)
+            public:
+            iterator(PolymerTrace &trace, size_t step) : trace{ &trace }, step{ step } { }
+            const CharCounts &operator*() const { return trace->HistogramAt(step); }
+            size_t Step() const { return step; }
+            iterator &operator++() { ++step; return *this; }
+            bool operator!=(const iterator &other) const { return step != other.step; }
+
+            private:
+            PolymerTrace *trace;
+            size_t step;
+        };
+        StepRange(PolymerTrace &trace, size_t first, size_t last) : first{ trace, first }, last{ trace, last } { }
+        iterator begin() const { return first; }
+        iterator end()   const { return last; }
+
+        private:
+        iterator first;
+        iterator last;
+    };
+    StepRange Steps(size_t first, size_t last) { return { *this, first, last }; }
+
+    /**
+     * @brief 
+     * Writes the furthest state as text:
+     *     polymer-checkpoint 1
+     *     step <k>
+     *     chars <26 counts>
+     *     pairs <n>
+     *     <pair index> <count>      (n lines, nonzero pairs only)
+     */
+    void SaveCheckpoint(std::ostream &out) const
+    {
+        out << "polymer-checkpoint 1\nstep " << FurthestStep() << "\nchars";
+        for (auto ch = size_t{ 0 }; ch < kAlphabetSize; ++ch) { out << ' ' << histograms.back()[ch]; }
+        const auto &kPairs = buffers[current];
+        out << "\npairs " << std::count_if(cbegin(kPairs), cbegin(kPairs) + kPairCount, [](uint64_t c){ return c > 0; }) << '\n';
+        for (auto idx = size_t{ 0 }; idx < kPairCount; ++idx)
+        {
+            if (kPairs[idx] > 0) { out << idx << ' ' << kPairs[idx] << '\n'; }
+        }
+    }
+
+    /**
+     * @brief Replaces the state with the one saved by SaveCheckpoint. Returns false and keeps the current state on malformed input.
+     */
+    bool LoadCheckpoint(std::istream &in)
+    {
+        auto word        = string{};
+        auto version     = 0;
+        auto step        = size_t{ 0 };
+        auto pair_lines  = size_t{ 0 };
+        auto char_counts = CharCounts{};
+        auto pairs       = PairCounts{};
+        if (!(in >> word >> version) || word != "polymer-checkpoint" || version != 1) { return false; }
+        if (!(in >> word >> step) || word != "step")                                 { return false; }
+        if (!(in >> word) || word != "chars")                                         { return false; }
+        for (auto ch = size_t{ 0 }; ch < kAlphabetSize; ++ch) { if (!(in >> char_counts[ch])) { return false; } }
+        if (!(in >> word >> pair_lines) || word != "pairs")                           { return false; }
+        for (auto line = size_t{ 0 }; line < pair_lines; ++line)
+        {
+            auto idx = size_t{ 0 };
+            auto count = uint64_t{ 0 };
+            if (!(in >> idx >> count) || idx >= kPairCount) { return false; }
+            pairs[idx] = count;
+        }
+        first_step = step;
+        current    = 0;
+        buffers[0] = pairs;
+        histograms.assign(1, char_counts);
+        overflowed = false;
+        return true;
+    }
+
+    private:
+    /**
+     * @brief Runs steps until {step} is reached or the next step overflows. Returns whether {step} was reached.
+     */
+    bool Advance(size_t step)
+    {
+        while (FurthestStep() < step && !overflowed)
+        {
+            auto char_counts = histograms.back();
+            if (!PolymerStep(rules, buffers[current], buffers[current ^ 1], char_counts))
             {
-                const auto kMappedChar                   = kRulesUmap.at(current_pair);
-                character_count_umap[kMappedChar]       += count;
-                const auto kLeftPair                     = pair{ current_pair.first, kMappedChar  };
-                const auto kRightPair                    = pair{ kMappedChar, current_pair.second };
-                new_pairs_count_map[kLeftPair]          += count;
-                new_pairs_count_map[kRightPair]         += count;
-                count                                    = 0;
+                overflowed = true;//buffers[current] still holds FurthestStep()
+                break;
             }
+            current ^= 1;
+            histograms.push_back(char_counts);
         }
-        for (const auto &[kNewInsertedPair, kNewPairCount] : new_pairs_count_map)
+        return FurthestStep() >= step;
+    }
+
+    PairRules          rules;
+    array<PairCounts, 2> buffers{};
+    size_t             current{ 0 };   //buffers[current] holds the pair counts of FurthestStep()
+    size_t             first_step{ 0 };
+    vector<CharCounts> histograms;     //histograms[i] is the histogram after first_step + i steps
+    bool               overflowed{ false };//the step after FurthestStep() does not fit in uint64_t
+};
+
+/**
+ * @brief 
+ * Unsigned 128-bit value that remembers whether any operation overflowed.
+ */
+struct Exact128
+{
+    unsigned __int128 value{ 0 };
+    bool overflow{ false };
+
+    friend Exact128 operator+(const Exact128 &a, const Exact128 &b)
+    {
+        auto r = Exact128{ 0, a.overflow || b.overflow };
+        r.overflow |= __builtin_add_overflow(a.value, b.value, &r.value);
+        return r;
+    }
+    friend Exact128 operator*(const Exact128 &a, const Exact128 &b)
+    {
+        auto r = Exact128{ 0, a.overflow || b.overflow };
+        r.overflow |= __builtin_mul_overflow(a.value, b.value, &r.value);
+        return r;
+    }
+    bool IsZero() const { return value == 0 && !overflow; }
+    string ToString() const
+    {
+        if (value == 0) { return "0"; }
+        auto str = string{};
+        for (auto v = value; v > 0; v /= 10) { str.push_back(static_cast<char>('0' + static_cast<int>(v % 10))); }
+        return { str.crbegin(), str.crend() };
+    }
+};
+
+/**
+ * @brief 
+ * Positive count held as mantissa * 2^exponent, with the mantissa in
+ * [0.5, 1) or exactly 0. The exponent absorbs any magnitude, so a nonzero
+ * count never underflows or overflows and is zero only when the exact count
+ * is zero. Only the leading 53 bits are kept, enough to order counts.
+ */
+struct ScaledCount
+{
+    double  mantissa{ 0 };
+    int64_t exponent{ 0 };
+
+    static ScaledCount Normalized(double mantissa, int64_t exponent)
+    {
+        if (mantissa == 0) { return {}; }
+        auto shift = 0;
+        mantissa = std::frexp(mantissa, &shift);
+        return { mantissa, exponent + shift };
+    }
+    friend ScaledCount operator+(const ScaledCount &a, const ScaledCount &b)
+    {
+        if (a.mantissa == 0) { return b; }
+        if (b.mantissa == 0) { return a; }
+        const auto &kHigh = a.exponent >= b.exponent ? a : b;
+        const auto &kLow  = a.exponent >= b.exponent ? b : a;
+        const auto kGap   = std::min<int64_t>(kHigh.exponent - kLow.exponent, 64);
+        return Normalized(kHigh.mantissa + std::ldexp(kLow.mantissa, static_cast<int>(-kGap)), kHigh.exponent);
+    }
+    friend ScaledCount operator*(const ScaledCount &a, const ScaledCount &b)
+    {
+        return Normalized(a.mantissa * b.mantissa, a.exponent + b.exponent);
+    }
+    friend bool operator<(const ScaledCount &a, const ScaledCount &b)
+    {
+        if (a.mantissa == 0 || b.mantissa == 0) { return a.mantissa < b.mantissa; }
+        return a.exponent != b.exponent ? a.exponent < b.exponent : a.mantissa < b.mantissa;
+    }
+};
+
+/**
+ * @brief 
+ * Pair transition matrix restricted to the pairs that can actually occur,
+ * i.e. the closure of the template's pairs under the rules. Column i holds
+ * the pairs produced by one occurrence of active pair i in one step, so
+ * counts after n steps are M^n * counts_0.
+ * Three element types are supported for M^n:
+ *   Exact128     exact counts, with overflow detection
+ *   uint64_t     counts modulo kModulus
+ *   ScaledCount  approximate counts, only used to order characters once
+ *                exact counts no longer fit in 128 bits
+ */
+class PolymerMatrix
+{
+    public:
+    static constexpr uint64_t kModulus = 1'000'000'007;
+
+    PolymerMatrix(string_view template_str, const PairRules &rules) : template_str{ template_str }
+    {
+        active_index.fill(-1);
+        auto pending = vector<size_t>{};
+        const auto kActivate = [&](size_t pair_idx)
+        {
+            if (pair_idx == kNoPair || active_index[pair_idx] >= 0) { return; }
+            active_index[pair_idx] = static_cast<int>(active_pairs.size());
+            active_pairs.push_back(pair_idx);
+            pending.push_back(pair_idx);
+        };
+        for (auto idx = size_t{ 1 }; idx < template_str.size(); ++idx) { kActivate(PairIndex(template_str[idx - 1], template_str[idx])); }
+        while (!pending.empty())
         {
-            pairs_count_map[kNewInsertedPair] += kNewPairCount;
+            const auto kPair = pending.back();
+            pending.pop_back();
+            kActivate(rules.left[kPair]);
+            kActivate(rules.right[kPair]);
+        }
+        size = active_pairs.size();
+        transition.assign(size * size, 0);
+        for (auto col = size_t{ 0 }; col < size; ++col)
+        {
+            const auto kPair = active_pairs[col];
+            ++transition[static_cast<size_t>(active_index[rules.left[kPair]]) * size + col];
+            if (rules.right[kPair] != kNoPair) { ++transition[static_cast<size_t>(active_index[rules.right[kPair]]) * size + col]; }
+        }
+    }
+
+    /**
+     * @brief max - min character count after {steps} steps, as a decimal string.
+     * When the exact counts overflow 128 bits, the result is reported modulo kModulus.
+     * Regression input test_underflow.txt (one B among 2^200 A's): 200 steps gives 499445071 (mod 1000000007).
+     */
+    string MaxMinDifference(uint64_t steps) const
+    {
+        if (size == 0) { return "0"; }
+        const auto kExact = CharCounts<Exact128>(Power<Exact128>(steps));
+        if (std::none_of(cbegin(kExact), cend(kExact), [](const Exact128 &c){ return c.overflow; }))
+        {
+            auto max_count = kExact[0].value, min_count = kExact[0].value;
+            auto any = false;
+            for (const auto &count : kExact)
+            {
+                if (count.IsZero()) { continue; }
+                max_count = any ? std::max(max_count, count.value) : count.value;
+                min_count = any ? std::min(min_count, count.value) : count.value;
+                any = true;
+            }
+            return Exact128{ max_count - min_count }.ToString();
+        }
+        //Too large to represent: pick the max/min characters from the scaled counts, then take
+        //their difference modulo kModulus. A scaled count is zero only for a character the
+        //polymer cannot contain, so it also tells which characters are present.
+        const auto kScaled  = CharCounts<ScaledCount>(Power<ScaledCount>(steps));
+        const auto kModular = CharCounts<uint64_t>(Power<uint64_t>(steps));
+        auto max_ch = kAlphabetSize, min_ch = kAlphabetSize;
+        for (auto ch = size_t{ 0 }; ch < kAlphabetSize; ++ch)
+        {
+            if (IsZero(kScaled[ch])) { continue; }
+            if (max_ch == kAlphabetSize || kScaled[max_ch] < kScaled[ch]) { max_ch = ch; }
+            if (min_ch == kAlphabetSize || kScaled[ch] < kScaled[min_ch]) { min_ch = ch; }
+        }
+        return std::to_string((kModular[max_ch] + kModulus - kModular[min_ch]) % kModulus) + " (mod " + std::to_string(kModulus) + ")";
+    }
+
+    private:
+    template<typename T>
+    using Matrix = vector<T>;//size x size, row major
+
+    template<typename T>
+    static T One()
+    {
+        if constexpr (std::is_same_v<T, ScaledCount>) { return ScaledCount::Normalized(1, 0); }
+        else                                          { return T{ 1 }; }
+    }
+
+    /**
+     * @brief M^steps by repeated squaring.
+     */
+    template<typename T>
+    Matrix<T> Power(uint64_t steps) const
+    {
+        auto base   = Matrix<T>(size * size);
+        std::transform(cbegin(transition), cend(transition), begin(base), [](uint8_t v){ return v == 0 ? T{} : (v == 1 ? One<T>() : One<T>() + One<T>()); });
+        auto result = Matrix<T>(size * size);
+        for (auto i = size_t{ 0 }; i < size; ++i) { result[i * size + i] = One<T>(); }
+        for (; steps > 0; steps >>= 1)
+        {
+            if (steps & 1) { result = Multiply(result, base); }
+            if (steps > 1) { base = Multiply(base, base); }
+            if constexpr (std::is_same_v<T, Exact128>)
+            {
+                //Overflow never clears, so stop as soon as it appears anywhere.
+                const auto kOverflowed = [](const Matrix<T> &m){ return std::any_of(cbegin(m), cend(m), [](const T &v){ return v.overflow; }); };
+                if (kOverflowed(base) || kOverflowed(result)) { result[0].overflow = true; break; }
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief 
+     * Character counts of the polymer described by M^steps applied to the
+     * template's pairs. Every character is the first character of exactly
+     * one pair, except the last character of the polymer, which is always
+     * the last character of the template.
+     */
+    template<typename T>
+    array<T, kAlphabetSize> CharCounts(const Matrix<T> &power) const
+    {
+        auto initial = vector<T>(size);
+        for (auto idx = size_t{ 1 }; idx < template_str.size(); ++idx)
+        {
+            auto &count = initial[static_cast<size_t>(active_index[PairIndex(template_str[idx - 1], template_str[idx])])];
+            count = count + One<T>();
+        }
+        auto chars = array<T, kAlphabetSize>{};
+        for (auto row = size_t{ 0 }; row < size; ++row)
+        {
+            auto pair_count = T{};
+            for (auto col = size_t{ 0 }; col < size; ++col) { pair_count = Add(pair_count, MulAdd(T{}, power[row * size + col], initial[col])); }
+            auto &count = chars[active_pairs[row] / kAlphabetSize];
+            count = Add(count, pair_count);
+        }
+        auto &last = chars[static_cast<size_t>(template_str.back() - 'A')];
+        last = Add(last, One<T>());
+        return chars;
+    }
+
+    //uint64_t counts are kept modulo kModulus
+    template<typename T>
+    static T Add(const T &a, const T &b)
+    {
+        if constexpr (std::is_same_v<T, uint64_t>) { return (a + b) % kModulus; }
+        else                                       { return a + b; }
+    }
+    template<typename T>
+    static T MulAdd(const T &acc, const T &a, const T &b)
+    {
+        if constexpr (std::is_same_v<T, uint64_t>) { return (acc + a * b) % kModulus; }
+        else                                       { return acc + a * b; }
+    }
+
+    /**
+     * @brief 
+     * i-k-j order so the innermost loop walks both b and c contiguously;
+     * zero entries of a (the matrix is sparse early on) are skipped.
+     * uint64_t: modular multiplication with lazy reduction. Entries are < 2^30,
+     * so each product is < 2^60 and up to 15 products can be summed into a
+     * uint64_t before reducing. The inner loop is then a plain multiply-add
+     * over a contiguous row, which the compiler vectorises.
+     */
+    template<typename T>
+    Matrix<T> Multiply(const Matrix<T> &a, const Matrix<T> &b) const
+    {
+        auto c = Matrix<T>(size * size);
+        if constexpr (std::is_same_v<T, uint64_t>)
+        {
+            constexpr auto kReduceEvery = size_t{ 15 };
+            auto acc = vector<uint64_t>(size);
+            for (auto i = size_t{ 0 }; i < size; ++i)
+            {
+                std::fill(begin(acc), end(acc), 0);
+                auto pending = size_t{ 0 };
+                for (auto k = size_t{ 0 }; k < size; ++k)
+                {
+                    const auto kA = a[i * size + k];
+                    if (kA == 0) { continue; }
+                    const auto *kRow = &b[k * size];
+                    for (auto j = size_t{ 0 }; j < size; ++j) { acc[j] += kA * kRow[j]; }
+                    if (++pending == kReduceEvery)
+                    {
+                        for (auto &v : acc) { v %= kModulus; }
+                        pending = 0;
+                    }
+                }
+                for (auto j = size_t{ 0 }; j < size; ++j) { c[i * size + j] = acc[j] % kModulus; }
+            }
+            return c;
+        }
+        else
+        {
+            for (auto i = size_t{ 0 }; i < size; ++i)
+            {
+                for (auto k = size_t{ 0 }; k < size; ++k)
+                {
+                    const auto &kA = a[i * size + k];
+                    if (IsZero(kA)) { continue; }
+                    for (auto j = size_t{ 0 }; j < size; ++j) { c[i * size + j] = MulAdd(c[i * size + j], kA, b[k * size + j]); }
+                }
+            }
+            return c;
         }
     }
 
-    auto [min_pos, max_pos] = minmax_element(cbegin(character_count_umap), cend(character_count_umap), [](const auto &p1, const auto &p2){
-        return p1.second < p2.second;
-    });
-    const auto &[kMaxOcurringChar, kMaxCount] = *max_pos;
-    const auto &[kMinOcurringChar, kMinCount] = *min_pos;
-    return kMaxCount - kMinCount;
+    static bool IsZero(const Exact128 &v)    { return v.IsZero(); }
+    static bool IsZero(const uint64_t &v)    { return v == 0; }
+    static bool IsZero(const ScaledCount &v) { return v.mantissa == 0; }
+
+    string                  template_str;
+    size_t                  size{ 0 };
+    array<int, kPairCount + 1> active_index;//pair index -> row/column in the matrix, -1 if inactive
+    vector<size_t>          active_pairs;   //row/column -> pair index
+    vector<uint8_t>         transition;
+};
+
+/**
+ * @brief Parses a whole string as a step count; nullopt if it is not a plain non-negative number.
+ */
+optional<size_t> ParseStep(string_view str)
+{
+    auto step = size_t{ 0 };
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), step);
+    if (ec != std::errc{} || ptr != str.data() + str.size() || str.empty()) { return nullopt; }
+    return step;
+}
+
+/**
+ * @brief Parses a comma separated list of step counts such as "10,40,100"; nullopt if any entry is invalid or the list is empty.
+ */
+optional<vector<size_t>> ParseSteps(string_view str)
+{
+    auto steps = vector<size_t>{};
+    while (!str.empty())
+    {
+        const auto kComma = std::min(str.find(','), str.size());
+        const auto kStep  = ParseStep(str.substr(0, kComma));
+        if (!kStep) { return nullopt; }
+        steps.push_back(*kStep);
+        str.remove_prefix(std::min(kComma + 1, str.size()));
+    }
+    if (steps.empty()) { return nullopt; }
+    return steps;
 }
 
 int main(int argc, const char *args[])
 {
+    const auto kUsage = [&]{
+        cout << "usage: " << args[0] << " <input file> [steps]\n"
+             << "       " << args[0] << " <input file> [--resume <checkpoint>] --trace <s1,s2,...> [--save <checkpoint>]\n";
+        return 1;
+    };
+    if (argc < 2) { return kUsage(); }
     cout << "Taking input from file : " << args[1] << "\n";
-    const auto [kTemplatesStr, kRulesMap] = ReadInput(args[1]);
+    const auto [kTemplatesStr, kRules] = ReadInput(args[1]);
     cout << "Day 14 : Extended Polymerization:\n";
-    cout << "Part 1 (10 steps): " << ApplyPolymerInsertionRules(kTemplatesStr, kRulesMap, 10) << "\n";
-    cout << "Part 2 (40 steps): " << ApplyPolymerInsertionRules(kTemplatesStr, kRulesMap, 40) << "\n";
+    if (argc > 2 && args[2][0] != '-')
+    {
+        const auto kSteps = ParseStep(args[2]);
+        if (!kSteps || argc > 3) { return kUsage(); }
+        cout << "After " << *kSteps << " steps: " << PolymerMatrix{ kTemplatesStr, kRules }.MaxMinDifference(*kSteps) << "\n";
+        return 0;
+    }
+    if (argc % 2 != 0) { return kUsage(); }//every flag takes one value
+
+    auto trace = PolymerTrace{ kTemplatesStr, kRules };
+    auto query_steps = vector<size_t>{};
+    auto save_path   = string{};
+    for (auto idx = 2; idx + 1 < argc; idx += 2)
+    {
+        const auto kFlag = string_view{ args[idx] };
+        if (kFlag == "--trace")
+        {
+            const auto kSteps = ParseSteps(args[idx + 1]);
+            if (!kSteps) { return kUsage(); }
+            query_steps = *kSteps;
+        }
+        else if (kFlag == "--save") { save_path = args[idx + 1]; }
+        else if (kFlag == "--resume")
+        {
+            if (auto fin = ifstream{ args[idx + 1] }; !trace.LoadCheckpoint(fin))
+            {
+                cout << "Could not load checkpoint " << args[idx + 1] << "\n";
+                return 1;
+            }
+            cout << "Resumed at step " << trace.FirstStep() << "\n";
+        }
+        else { return kUsage(); }
+    }
+    //Steps whose counts no longer fit in uint64_t are answered by the matrix path instead
+    const auto kMatrix = PolymerMatrix{ kTemplatesStr, kRules };
+    const auto kReport = [&](const string &label, size_t step)
+    {
+        if (step < trace.FirstStep()) { cout << label << ": before checkpoint\n"; }
+        else if (trace.IsExactAt(step)) { cout << label << ": " << trace.MaxMinDifferenceAt(step) << "\n"; }
+        else                            { cout << label << ": " << kMatrix.MaxMinDifference(step) << " (matrix)\n"; }
+    };
+    if (query_steps.empty())
+    {
+        //Part 2 continues from the state Part 1 left behind
+        kReport("Part 1 (10 steps)", 10);
+        kReport("Part 2 (40 steps)", 40);
+    }
+    for (const auto &step : query_steps) { kReport("Step " + std::to_string(step), step); }
+    if (!save_path.empty())
+    {
+        auto fout = std::ofstream{ save_path };
+        trace.SaveCheckpoint(fout);
+        cout << "Saved step " << trace.FurthestStep() << " to " << save_path << "\n";
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -2,15 +2,12 @@
  * @file day_15_chiton.cpp
  * @author Usama Tayyab (usamatayyab9@gmail.com)
  * @brief
- * Compilation command : g++ -std=c++17 ./day_15_chiton.cpp
+ * Compilation command : g++ -std=c++17 -O2 -pthread ./day_15_chiton.cpp
  * Problem statement is aviailable at : https://adventofcode.com/2021/day/15
  * 
  * Solution:
  * For solving this problem I used dijkstra algorithm for finding the path
  * with minimum cost.
- * - `IsValInRange()` Function:
- *      This function checks if a given value lies within a specified range.
- * 
  * - `Grid` Class:
  *      Represents a 2D grid. It provides functionality to access elements, get the number of rows and columns,
  *      and add rows to the grid.
@@ -20,22 +17,33 @@
  *      scaling factor. When accessing elements, if an index exceeds the dimensions of the base grid, it wraps
  *      around to repeat the content.
  * 
+ * - `MaterializedGrid` Class:
+ *      Same content as `ScaledRepeatedGrid`, but computed once into a contiguous byte buffer so each
+ *      access is a single load. Used by default; `--lazy` switches back to `ScaledRepeatedGrid`.
+ * 
  * - `ReadInput()` Function:
  *      Reads input from a file and constructs a grid based on the contents of the file.
  * 
- * - `MinimumCostPath()` Function:
- *      Finds the minimum cost path through the grid. It uses Dijkstra's algorithm with a priority queue.
- *      It maintains a queue of elements representing positions in the grid along with their costs. It iteratively
- *      explores neighboring cells, updating the cost and adding them to the queue if necessary. The algorithm
- *      terminates when it reaches the bottom-right cell of the grid.
+ * - `RunSearch()` Function:
+ *      Finds the minimum cost path through the grid with the selected search. The default,
+ *      `DijkstraSearch()`, uses Dijkstra's algorithm with a bucket queue (Dial's algorithm), which
+ *      works because every risk level is between 1 and 9. It iteratively explores neighboring cells,
+ *      updating the cost and adding them to the bucket of their new cost. The search terminates when
+ *      it reaches the bottom-right cell of the grid.
  * 
  * See function comments for more dtails.
  * 
  * Driver code :
  * This program expects one additional argument via command line. This argument is treated as an input file path.
+ * Optionally a scale factor for Part 2 (default 5), `--lazy` and the search algorithm can follow it:
+ *      a.out input.txt 25 --lazy --algo astar
+ * Algorithms: dijkstra (default), astar (min risk * Manhattan distance heuristic), bidir
+ * (bidirectional Dijkstra) and delta (parallel delta-stepping, `--threads n`). The number of
+ * expanded cells is reported with each answer. `--bench` compares sequential Dijkstra with
+ * delta-stepping at 1/2/4/8/16 threads on the scaled grid.
  * Read the data from a file in a grid object.
  * Construct a scaled grid object from the above grid object(Used for Part 2).
- * Use `MinimumCostPath()` for both normal and scaled grid to computed minimum cost.
+ * Use `RunSearch()` for both normal and scaled grid to computed minimum cost.
  * 
  * @copyright Copyright (c) 2024
  * 
@@ -47,10 +55,20 @@
 #include <vector>
 #include <algorithm>
 #include <iterator>
-#include <queue>
-#include <set>
 #include <array>
 #include <exception>
+#include <stdexcept>
+#include <limits>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
+#include <optional>
+#include <charconv>
+#include <system_error>
 
 using std::array;
 using std::back_inserter;
@@ -64,24 +82,11 @@ using std::istream_iterator;
 using std::transform;
 using std::pair;
 using std::vector;
-using std::priority_queue;
-using std::set;
+using std::optional;
+using std::nullopt;
 
 /**
- * @brief  Function to check if a value is within a specified range
- * @param value 
- * @param min 
- * @param max 
- * @return true 
- * @return false 
- */
-bool IsValInRange(const auto &value, const auto &min, const auto &max)
-{
-    return value >= min && value < max;
-}
-
-/**
- * @brief Class representing a 2D grid
+ * @brief Class representing a 2D grid, stored row by row in one contiguous buffer
  * 
  */
 class Grid
@@ -90,27 +95,32 @@ public:
     Grid() = default;
 
     /**
-     * @brief Accessor for reading elements (const version)
+     * @brief Accessor for reading elements (const version). Indices are not bounds checked.
      * @param i - Row index
      * @param j - Columne Index
      * @return const int& 
      */
     const int & operator()(const size_t &i, const size_t &j) const
     {
-        return data.at(i).at(j);
+        return data[i * column_count + j];
     }
     int& operator()(const size_t &i, const size_t &j)
     {
-        return data.at(i).at(j);
+        return data[i * column_count + j];
     }
-    size_t RowCount() const { return size(data); }
-    size_t ColumnCount() const { return 0 == size(data) ? 0 : size(data[0]); }
+    size_t RowCount() const { return row_count; }
+    size_t ColumnCount() const { return column_count; }
     void Pushback(const vector<int> &vec)
     {
-        data.push_back(vec);
+        if (0 == row_count) { column_count = size(vec); }
+        if (size(vec) != column_count) { throw std::invalid_argument{ "All rows of a grid must have the same length" }; }
+        data.insert(cend(data), cbegin(vec), cend(vec));
+        ++row_count;
     }
 private:
-    vector<vector<int>> data;
+    vector<int> data;
+    size_t row_count{ 0 };
+    size_t column_count{ 0 };
 };
 
 /**
@@ -120,7 +130,7 @@ private:
 class ScaledRepeatedGrid
 {
     public :
-    ScaledRepeatedGrid(const Grid &grid_arg, const int &scaled_factor) :
+    ScaledRepeatedGrid(const Grid &grid_arg, const size_t &scaled_factor) :
         single_tile{ grid_arg },
         scale_factor { scaled_factor }
     {
@@ -131,9 +141,9 @@ class ScaledRepeatedGrid
      * 
      * @param i 
      * @param j 
-     * @return const int 
+     * @return int 
      */
-    const int operator()(const size_t &i, const size_t &j) const
+    int operator()(const size_t &i, const size_t &j) const
     {
         if (i >= RowCount() || j >= ColumnCount())
         {
@@ -144,20 +154,64 @@ class ScaledRepeatedGrid
         const auto kRowShiftFactor  = i / single_tile.RowCount();
         const auto kColShiftFactor  = j / single_tile.ColumnCount();
         const auto kOriginalElement = single_tile(kOriginalRowIdx, kOriginalColIdx);
-        auto       shifted_value    = kOriginalElement + kRowShiftFactor + kColShiftFactor;
-        if (shifted_value > 9)
-        {
-            shifted_value -= 9; 
-        }
-        return shifted_value;
+        //risk levels wrap from 9 back to 1, for any number of increments
+        return static_cast<int>((kOriginalElement - 1 + kRowShiftFactor + kColShiftFactor) % 9 + 1);
     }
 
     size_t RowCount() const { return single_tile.RowCount() * scale_factor; }
     size_t ColumnCount() const { return 0 == single_tile.RowCount() ? 0 : single_tile.ColumnCount() * scale_factor; }
 
     private:
-    int scale_factor{ 1 };
     Grid single_tile;
+    size_t scale_factor{ 1 };
+};
+
+/**
+ * @brief Scaled grid materialised once into a contiguous uint8_t buffer
+ * 
+ * Every tile (tile_row, tile_col) is the base grid with all risks raised by
+ * k = tile_row + tile_col, wrapping 9 back to 1. Each tile row is produced
+ * by a branch-free add and conditional subtract over bytes, which the
+ * compiler vectorises, so reading a cell afterwards is a single load.
+ */
+class MaterializedGrid
+{
+    public:
+    MaterializedGrid(const Grid &grid_arg, const size_t &scaled_factor) :
+        row_count{ grid_arg.RowCount() * scaled_factor },
+        column_count{ grid_arg.ColumnCount() * scaled_factor },
+        data(row_count * column_count)
+    {
+        const auto kTileRows = grid_arg.RowCount();
+        const auto kTileCols = grid_arg.ColumnCount();
+        auto base_row = vector<uint8_t>(kTileCols);
+        for (auto row = size_t{ 0 }; row < kTileRows; ++row)
+        {
+            for (auto col = size_t{ 0 }; col < kTileCols; ++col) { base_row[col] = static_cast<uint8_t>(grid_arg(row, col)); }
+            for (auto tile_row = size_t{ 0 }; tile_row < scaled_factor; ++tile_row)
+            {
+                auto *out = &data[(tile_row * kTileRows + row) * column_count];
+                for (auto tile_col = size_t{ 0 }; tile_col < scaled_factor; ++tile_col, out += kTileCols)
+                {
+                    const auto kShift = static_cast<uint8_t>((tile_row + tile_col) % 9);
+                    for (auto col = size_t{ 0 }; col < kTileCols; ++col)
+                    {
+                        const auto kShifted = static_cast<uint8_t>(base_row[col] + kShift);
+                        out[col] = static_cast<uint8_t>(kShifted - (kShifted > 9 ? 9 : 0));
+                    }
+                }
+            }
+        }
+    }
+
+    int operator()(const size_t &i, const size_t &j) const { return data[i * column_count + j]; }
+    size_t RowCount() const { return row_count; }
+    size_t ColumnCount() const { return column_count; }
+
+    private:
+    size_t row_count{ 0 };
+    size_t column_count{ 0 };
+    vector<uint8_t> data;
 };
 
 /**
@@ -181,71 +235,465 @@ Grid ReadInput(string_view filename)
 }
 
 /**
- * @brief Computes the minimum cost of traversing from top left of the grid to
- * bottom right. Uses Dijkstra algorithm to find minimum cost.
+ * @brief Result of a shortest path search: the minimum cost and the number of cells expanded
+ */
+struct SearchResult
+{
+    size_t cost{ 0 };
+    size_t expansions{ 0 };
+};
+
+constexpr auto kMaxRisk   = uint32_t{ 9 };
+constexpr auto kUnreached = std::numeric_limits<uint32_t>::max();
+
+/**
+ * @brief Best-first search from top left to bottom right ordered by
+ * key = distance + heuristic(cell), using a circular bucket queue (Dial's
+ * algorithm). With a consistent heuristic the key of a newly pushed cell is
+ * at most {max_key_step} above the key being expanded, so {max_key_step} + 1
+ * buckets indexed by key % bucket count are enough and every queue operation
+ * is O(1). Distances live in one flat uint32_t array indexed by
+ * row * columns + column.
  * 
  * @tparam GridType 
  * @param grid 
- * @return size_t 
+ * @param heuristic - callable (row, col) -> lower bound on the remaining cost
+ * @param max_key_step - largest possible increase of the key along one move
+ * @return SearchResult 
  */
-template<class GridType>
-size_t MinimumCostPath(const GridType &grid)
+template<class GridType, class Heuristic>
+SearchResult BucketSearch(const GridType &grid, Heuristic heuristic, uint32_t max_key_step)
 {
-    struct PriorityQueuElement
+    const auto kRows    = grid.RowCount();
+    const auto kColumns = grid.ColumnCount();
+    if (0 == kRows || 0 == kColumns) { return {}; }
+    const auto kTarget      = static_cast<uint32_t>(kRows * kColumns - 1);
+    const auto kBucketCount = max_key_step + 1;
+
+    auto dist    = vector<uint32_t>(kRows * kColumns, kUnreached);
+    auto buckets = vector<vector<uint32_t>>(kBucketCount);
+    auto queued  = size_t{ 1 };
+    auto result  = SearchResult{};
+    dist[0] = 0;//Initial cost of visiting (0,0) is 0 as we are already in that cell
+    buckets[heuristic(0, 0) % kBucketCount].push_back(0);
+    const auto kRelax = [&](uint32_t cost_so_far, size_t row, size_t col)
     {
-        size_t cost_so_far{ 0 };
-        long long row_idx;
-        long long col_idx;
-        bool operator<(const PriorityQueuElement &other) const
+        const auto kIdx     = static_cast<uint32_t>(row * kColumns + col);
+        const auto kNewCost = cost_so_far + static_cast<uint32_t>(grid(row, col));
+        if (kNewCost < dist[kIdx])
         {
-            return other.cost_so_far < cost_so_far;
+            dist[kIdx] = kNewCost;
+            buckets[(kNewCost + heuristic(row, col)) % kBucketCount].push_back(kIdx);
+            ++queued;
         }
     };
-    constexpr auto kDirectionsOffsets = array<pair<int, int>, 4>{{
-                 { -1, 0 },
-        { 0, -1 },        { 0, +1 },
-                { +1, 0 }
-    }};
-    auto minimum_costs_queue = priority_queue<PriorityQueuElement>{ };// Heap for retreiving lowest cost indices
-    auto total_minum_cost    = size_t{ 0 };
-    minimum_costs_queue.push(PriorityQueuElement{ 0, 0, 0 }); //Initial cost of visiting (0,0) is 0 as we are already in that cell
-    vector<vector<long long>> dist(grid.RowCount(), vector<long long>(grid.ColumnCount(), std::numeric_limits<long long>::max()));
-    dist[0][0] = 0;
-    while (false == minimum_costs_queue.empty())
-    {
-        const auto [minimum_cost_so_far, row_idx, col_idx] = minimum_costs_queue.top();
-        minimum_costs_queue.pop();
-        if (row_idx == grid.RowCount() - 1 && col_idx == grid.ColumnCount() - 1)
+    for (auto key = heuristic(0, 0); queued > 0; ++key)
+    {
+        auto &bucket = buckets[key % kBucketCount];
+        //a consistent heuristic and risk >= 1 keep pushes out of the bucket being drained, except for equal keys
+        for (auto pos = size_t{ 0 }; pos < size(bucket); ++pos)
         {
-            //coming here would mean we have reached the bottom right cell
-            total_minum_cost = minimum_cost_so_far;
-            break;           
+            const auto kIdx = bucket[pos];
+            const auto kRow = kIdx / kColumns;
+            const auto kCol = kIdx % kColumns;
+            if (dist[kIdx] + heuristic(kRow, kCol) != key) { continue; }//stale entry, a cheaper path was found later
+            if (kIdx == kTarget) { result.cost = dist[kIdx]; return result; }//reached the bottom right cell
+            ++result.expansions;
+            const auto kCostSoFar = dist[kIdx];
+            if (kRow > 0)            { kRelax(kCostSoFar, kRow - 1, kCol); }
+            if (kRow + 1 < kRows)    { kRelax(kCostSoFar, kRow + 1, kCol); }
+            if (kCol > 0)            { kRelax(kCostSoFar, kRow, kCol - 1); }
+            if (kCol + 1 < kColumns) { kRelax(kCostSoFar, kRow, kCol + 1); }
         }
-        for (const auto &[kRowOffset, kColumnOffset] : kDirectionsOffsets)
+        queued -= size(bucket);
+        bucket.clear();
+    }
+    result.cost = dist[kTarget];
+    return result;
+}
+
+/**
+ * @brief Plain Dijkstra: BucketSearch without a heuristic.
+ */
+template<class GridType>
+SearchResult DijkstraSearch(const GridType &grid)
+{
+    return BucketSearch(grid, [](size_t, size_t){ return uint32_t{ 0 }; }, kMaxRisk);
+}
+
+/**
+ * @brief A* with heuristic h = (smallest risk in the grid) * (Manhattan distance to the bottom right).
+ * Every remaining move enters a cell costing at least the smallest risk, so h never overestimates,
+ * and it changes by exactly that smallest risk per move, so it is consistent.
+ */
+template<class GridType>
+SearchResult AStarSearch(const GridType &grid)
+{
+    auto min_risk = kMaxRisk;
+    for (auto row = size_t{ 0 }; row < grid.RowCount(); ++row)
+    {
+        for (auto col = size_t{ 0 }; col < grid.ColumnCount(); ++col) { min_risk = std::min(min_risk, static_cast<uint32_t>(grid(row, col))); }
+    }
+    const auto kLastRow = grid.RowCount() - 1;
+    const auto kLastCol = grid.ColumnCount() - 1;
+    const auto kHeuristic = [&](size_t row, size_t col){ return min_risk * static_cast<uint32_t>((kLastRow - row) + (kLastCol - col)); };
+    //key grows by risk(v) + h(v) - h(u) <= 9 + min_risk per move
+    return BucketSearch(grid, kHeuristic, kMaxRisk + min_risk);
+}
+
+/**
+ * @brief Bidirectional Dijkstra meeting in the middle.
+ * The forward search runs from the top left, the backward search from the
+ * bottom right over reversed moves (entering cell v costs risk(v), so going
+ * back from v to u costs risk(v)). Both sides use bucket queues and always
+ * expand the side with the smaller current distance. Whenever a move links a
+ * cell settled on one side to a cell reached by the other, the total is a
+ * candidate for the answer; the search stops once the two frontier distances
+ * add up to at least the best candidate.
+ */
+template<class GridType>
+SearchResult BidirectionalSearch(const GridType &grid)
+{
+    constexpr auto kBucketCount = kMaxRisk + 1;
+    const auto kRows    = grid.RowCount();
+    const auto kColumns = grid.ColumnCount();
+    if (0 == kRows || 0 == kColumns) { return {}; }
+    const auto kCells   = kRows * kColumns;
+    if (1 == kCells) { return {}; }
+
+    struct Side
+    {
+        vector<uint32_t> dist;
+        vector<vector<uint32_t>> buckets;
+        size_t queued{ 1 };
+        uint32_t level{ 0 };
+    };
+    auto sides = array<Side, 2>{};//0 = forward, 1 = backward
+    for (auto &side : sides)
+    {
+        side.dist.assign(kCells, kUnreached);
+        side.buckets.resize(kBucketCount);
+    }
+    sides[0].dist[0] = 0;
+    sides[0].buckets[0].push_back(0);
+    sides[1].dist[kCells - 1] = 0;
+    sides[1].buckets[0].push_back(static_cast<uint32_t>(kCells - 1));
+
+    auto best   = uint64_t{ kUnreached };
+    auto result = SearchResult{};
+    const auto kRisk = [&](uint32_t idx){ return static_cast<uint32_t>(grid(idx / kColumns, idx % kColumns)); };
+    while (sides[0].queued > 0 && sides[1].queued > 0 && uint64_t{ sides[0].level } + sides[1].level < best)
+    {
+        const auto kSideIdx = (sides[0].level <= sides[1].level) ? 0 : 1;
+        auto &side  = sides[kSideIdx];
+        auto &other = sides[kSideIdx ^ 1];
+        auto &bucket = side.buckets[side.level % kBucketCount];
+        for (auto pos = size_t{ 0 }; pos < size(bucket); ++pos)
         {
-            const auto kRowIdxToProcess = row_idx + kRowOffset;
-            const auto kColIdxToProcess = col_idx + kColumnOffset;
-            if (IsValInRange(kRowIdxToProcess, 0, grid.RowCount()) &&
-                IsValInRange(kColIdxToProcess, 0, grid.ColumnCount()) &&
-                dist[row_idx][col_idx] + grid(kRowIdxToProcess, kColIdxToProcess) < dist[kRowIdxToProcess][kColIdxToProcess]
-            )
+            const auto kIdx = bucket[pos];
+            if (side.dist[kIdx] != side.level) { continue; }//stale entry
+            ++result.expansions;
+            const auto kRow = kIdx / kColumns;
+            const auto kCol = kIdx % kColumns;
+            const auto kRelax = [&](uint32_t next)
             {
-                dist[kRowIdxToProcess][kColIdxToProcess] = dist[row_idx][col_idx] + grid(kRowIdxToProcess, kColIdxToProcess);
-                minimum_costs_queue.push(
-                    PriorityQueuElement{ static_cast<size_t>(grid(kRowIdxToProcess, kColIdxToProcess)) + minimum_cost_so_far,
-                    kRowIdxToProcess, kColIdxToProcess } 
-                );
+                //forward: entering next costs risk(next); backward: stepping back out of kIdx costs risk(kIdx)
+                const auto kNewCost = side.level + (kSideIdx == 0 ? kRisk(next) : kRisk(kIdx));
+                if (other.dist[next] != kUnreached) { best = std::min(best, uint64_t{ kNewCost } + other.dist[next]); }
+                if (kNewCost < side.dist[next])
+                {
+                    side.dist[next] = kNewCost;
+                    side.buckets[kNewCost % kBucketCount].push_back(next);
+                    ++side.queued;
+                }
+            };
+            if (kRow > 0)            { kRelax(static_cast<uint32_t>(kIdx - kColumns)); }
+            if (kRow + 1 < kRows)    { kRelax(static_cast<uint32_t>(kIdx + kColumns)); }
+            if (kCol > 0)            { kRelax(kIdx - 1); }
+            if (kCol + 1 < kColumns) { kRelax(kIdx + 1); }
+        }
+        side.queued -= size(bucket);
+        bucket.clear();
+        ++side.level;
+    }
+    result.cost = static_cast<size_t>(best);
+    return result;
+}
+
+/**
+ * @brief Reusable barrier for a fixed number of threads (std::barrier needs C++20).
+ */
+class Barrier
+{
+    public:
+    explicit Barrier(size_t thread_count) : kThreadCount{ thread_count } { }
+    void ArriveAndWait()
+    {
+        auto lock = std::unique_lock{ mutex };
+        const auto kGeneration = generation;
+        if (++arrived == kThreadCount)
+        {
+            arrived = 0;
+            ++generation;
+            condition.notify_all();
+            return;
+        }
+        condition.wait(lock, [&]{ return generation != kGeneration; });
+    }
+
+    private:
+    const size_t kThreadCount;
+    size_t arrived{ 0 };
+    size_t generation{ 0 };
+    std::mutex mutex;
+    std::condition_variable condition;
+};
+
+/**
+ * @brief Parallel delta-stepping shortest path.
+ * Tentative distances are an array of std::atomic<uint32_t> lowered with a
+ * compare-and-swap loop, so threads relax edges without locks. Cells are
+ * kept in buckets of width {delta}; moves into a cell of risk <= delta are
+ * "light" and may land back in the current bucket, heavier moves are
+ * "heavy" and always land in a later bucket. For the current bucket the
+ * threads repeatedly relax the light moves of every cell in it until it
+ * stays empty, then relax the heavy moves of all cells settled in it once.
+ * Every thread owns its own buckets (a cell goes to the thread that lowered
+ * its distance); threads meet at a barrier between phases to agree on the
+ * next bucket and on whether the current one is finished. The search stops
+ * once the current bucket lies beyond the target's distance.
+ * With risks 1...9, delta = 3 keeps re-relaxation inside a bucket low while
+ * still giving every phase enough cells to share between threads.
+ */
+template<class GridType>
+SearchResult DeltaSteppingSearch(const GridType &grid, unsigned thread_count, uint32_t delta = 3)
+{
+    const auto kRows    = grid.RowCount();
+    const auto kColumns = grid.ColumnCount();
+    if (0 == kRows || 0 == kColumns) { return {}; }
+    const auto kCells  = kRows * kColumns;
+    const auto kTarget = kCells - 1;
+    thread_count = std::max(1u, thread_count);
+    delta        = std::max(1u, delta);
+
+    auto dist = std::unique_ptr<std::atomic<uint32_t>[]>(new std::atomic<uint32_t>[kCells]);
+    for (auto idx = size_t{ 0 }; idx < kCells; ++idx) { dist[idx].store(kUnreached, std::memory_order_relaxed); }
+    dist[0].store(0, std::memory_order_relaxed);
+
+    struct alignas(64) ThreadState
+    {
+        vector<vector<uint32_t>> buckets;//bucket number -> cells
+        vector<uint32_t> settled;        //cells taken out of the current bucket, for the heavy moves
+        size_t next_bucket{ 0 };         //smallest non-empty bucket number, kNoBucket if none
+        bool has_current{ false };
+        size_t expansions{ 0 };
+    };
+    constexpr auto kNoBucket = std::numeric_limits<size_t>::max();
+    auto states = vector<ThreadState>(thread_count);
+    states[0].buckets.resize(1);
+    states[0].buckets[0].push_back(0);
+    auto barrier        = Barrier{ thread_count };
+    auto current_bucket = size_t{ 0 };//written by thread 0 between barriers
+
+    const auto kWorker = [&](unsigned thread_idx)
+    {
+        auto &self = states[thread_idx];
+        const auto kPush = [&](uint32_t cell, uint32_t cost)
+        {
+            const auto kBucket = cost / delta;
+            if (size(self.buckets) <= kBucket) { self.buckets.resize(kBucket + 1); }
+            self.buckets[kBucket].push_back(cell);
+        };
+        //Lowers dist[next] to cost, returns true if this thread made it lower
+        const auto kRelax = [&](uint32_t next, uint32_t cost)
+        {
+            auto old = dist[next].load(std::memory_order_relaxed);
+            while (cost < old)
+            {
+                if (dist[next].compare_exchange_weak(old, cost, std::memory_order_relaxed)) { kPush(next, cost); return; }
+            }
+        };
+        const auto kForEachMove = [&](uint32_t idx, auto func)
+        {
+            const auto kRow = idx / kColumns;
+            const auto kCol = idx % kColumns;
+            if (kRow > 0)            { func(static_cast<uint32_t>(idx - kColumns), kRow - 1, kCol); }
+            if (kRow + 1 < kRows)    { func(static_cast<uint32_t>(idx + kColumns), kRow + 1, kCol); }
+            if (kCol > 0)            { func(idx - 1, kRow, kCol - 1); }
+            if (kCol + 1 < kColumns) { func(idx + 1, kRow, kCol + 1); }
+        };
+        const auto kFindNextBucket = [&](size_t from)
+        {
+            for (auto bucket = from; bucket < size(self.buckets); ++bucket)
+            {
+                if (!self.buckets[bucket].empty()) { return bucket; }
             }
+            return kNoBucket;
+        };
+        auto frontier = vector<uint32_t>{};
+        while (true)
+        {
+            //1. agree on the next bucket to process
+            self.next_bucket = kFindNextBucket(current_bucket);
+            barrier.ArriveAndWait();
+            if (0 == thread_idx)
+            {
+                auto next = kNoBucket;
+                for (const auto &state : states) { next = std::min(next, state.next_bucket); }
+                const auto kTargetDist = dist[kTarget].load(std::memory_order_relaxed);
+                if (kTargetDist != kUnreached && next != kNoBucket && next > kTargetDist / delta) { next = kNoBucket; }
+                current_bucket = next;
+            }
+            barrier.ArriveAndWait();
+            if (kNoBucket == current_bucket) { break; }
+
+            //2. light phases until the bucket stays empty on every thread
+            while (true)
+            {
+                frontier.clear();
+                if (current_bucket < size(self.buckets)) { frontier.swap(self.buckets[current_bucket]); }
+                for (const auto &idx : frontier)
+                {
+                    const auto kCost = dist[idx].load(std::memory_order_relaxed);
+                    if (kCost / delta != current_bucket) { continue; }//stale entry
+                    ++self.expansions;
+                    self.settled.push_back(idx);
+                    kForEachMove(idx, [&](uint32_t next, size_t row, size_t col)
+                    {
+                        const auto kRisk = static_cast<uint32_t>(grid(row, col));
+                        if (kRisk <= delta) { kRelax(next, kCost + kRisk); }
+                    });
+                }
+                barrier.ArriveAndWait();
+                self.has_current = current_bucket < size(self.buckets) && !self.buckets[current_bucket].empty();
+                barrier.ArriveAndWait();
+                if (std::none_of(cbegin(states), cend(states), [](const ThreadState &state){ return state.has_current; })) { break; }
+                barrier.ArriveAndWait();//nobody may reset has_current before every thread has read it
+            }
+
+            //3. heavy moves out of every cell settled in this bucket
+            for (const auto &idx : self.settled)
+            {
+                const auto kCost = dist[idx].load(std::memory_order_relaxed);
+                kForEachMove(idx, [&](uint32_t next, size_t row, size_t col)
+                {
+                    const auto kRisk = static_cast<uint32_t>(grid(row, col));
+                    if (kRisk > delta) { kRelax(next, kCost + kRisk); }
+                });
+            }
+            self.settled.clear();
+            barrier.ArriveAndWait();
         }
+    };
+    auto workers = vector<std::thread>{};
+    for (auto thread_idx = 1u; thread_idx < thread_count; ++thread_idx) { workers.emplace_back(kWorker, thread_idx); }
+    kWorker(0);
+    for (auto &worker : workers) { worker.join(); }
+
+    auto result = SearchResult{ dist[kTarget].load(), 0 };
+    for (const auto &state : states) { result.expansions += state.expansions; }
+    return result;
+}
+
+/**
+ * @brief Times sequential bucket-queue Dijkstra against delta-stepping at 1, 2, 4, 8 and 16 threads.
+ */
+template<class GridType>
+void RunParallelBenchmark(const GridType &grid)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto kMs = [](Clock::duration d){ return std::chrono::duration<double, std::milli>(d).count(); };
+    auto start = Clock::now();
+    const auto kSequential = DijkstraSearch(grid);
+    const auto kSequentialMs = kMs(Clock::now() - start);
+    cout << "grid " << grid.RowCount() << " x " << grid.ColumnCount() << "\n";
+    cout << "sequential dijkstra: " << kSequential.cost << " in " << kSequentialMs << " ms\n";
+    for (const auto threads : { 1u, 2u, 4u, 8u, 16u })
+    {
+        start = Clock::now();
+        const auto kParallel = DeltaSteppingSearch(grid, threads);
+        const auto kParallelMs = kMs(Clock::now() - start);
+        cout << "delta-stepping, " << threads << " threads: " << kParallel.cost << " in " << kParallelMs
+             << " ms (speedup " << kSequentialMs / kParallelMs << "x)\n";
     }
-    return total_minum_cost;
+}
+
+/**
+ * @brief Names accepted by RunSearch() and by `--algo`.
+ */
+constexpr auto kAlgorithms = array<string_view, 4>{ "dijkstra", "astar", "bidir", "delta" };
+
+/**
+ * @brief Runs the search selected by {algorithm} ("dijkstra", "astar", "bidir" or "delta").
+ */
+template<class GridType>
+SearchResult RunSearch(const GridType &grid, string_view algorithm, unsigned thread_count)
+{
+    if (algorithm == "delta") { return DeltaSteppingSearch(grid, thread_count); }
+    if (algorithm == "astar") { return AStarSearch(grid); }
+    if (algorithm == "bidir") { return BidirectionalSearch(grid); }
+    return DijkstraSearch(grid);
+}
+
+/**
+ * @brief Parses a whole argument as a positive count; nullopt if it is not one.
+ */
+optional<size_t> ParsePositive(string_view str)
+{
+    auto value = size_t{ 0 };
+    const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc{} || ptr != str.data() + str.size() || value == 0) { return nullopt; }
+    return value;
 }
 
 int main(int argc, const char *args[])
 {
-    const auto kGrid       = ReadInput(args[1]);
-    const auto kScaledGrid = ScaledRepeatedGrid{ kGrid, 5 };
-    cout << "Part 1 : " << MinimumCostPath(kGrid) << "\n";
-    cout << "Part 2 : " << MinimumCostPath(kScaledGrid) << "\n";
+    const auto kUsage = [&]{
+        cout << "usage: " << args[0] << " <input file> [scale factor] [--lazy] [--algo dijkstra|astar|bidir|delta] [--threads n] [--bench]\n";
+        return 1;
+    };
+    if (argc < 2) { return kUsage(); }
+    auto scale     = size_t{ 5 };
+    auto lazy      = false;
+    auto bench     = false;
+    auto algorithm = string_view{ "dijkstra" };
+    auto threads   = std::max(1u, std::thread::hardware_concurrency());
+    for (auto idx = 2; idx < argc; ++idx)
+    {
+        const auto kArg = string_view{ args[idx] };
+        if (kArg == "--lazy")       { lazy = true; }
+        else if (kArg == "--bench") { bench = true; }
+        else if (kArg == "--algo")
+        {
+            if (idx + 1 == argc) { return kUsage(); }
+            algorithm = args[++idx];
+            if (std::find(cbegin(kAlgorithms), cend(kAlgorithms), algorithm) == cend(kAlgorithms)) { return kUsage(); }
+        }
+        else if (kArg == "--threads")
+        {
+            const auto kThreads = idx + 1 < argc ? ParsePositive(args[++idx]) : nullopt;
+            if (!kThreads || *kThreads > std::numeric_limits<unsigned>::max()) { return kUsage(); }
+            threads = static_cast<unsigned>(*kThreads);
+        }
+        else
+        {
+            const auto kScale = ParsePositive(kArg);
+            if (!kScale) { return kUsage(); }
+            scale = *kScale;
+        }
+    }
+    const auto kGrid = ReadInput(args[1]);
+    if (bench)
+    {
+        RunParallelBenchmark(MaterializedGrid{ kGrid, scale });
+        return 0;
+    }
+    const auto kPrint = [](const char *label, const SearchResult &result)
+    {
+        cout << label << result.cost << " (" << result.expansions << " cells expanded)\n";
+    };
+    kPrint("Part 1 : ", RunSearch(kGrid, algorithm, threads));
+    if (lazy) { kPrint("Part 2 : ", RunSearch(ScaledRepeatedGrid{ kGrid, scale }, algorithm, threads)); }
+    else      { kPrint("Part 2 : ", RunSearch(MaterializedGrid{ kGrid, scale }, algorithm, threads)); }
     return 0;
-}
\ No newline at end of file
+}
@@ -2,7 +2,7 @@
  * @file packet_decoder.cpp
  * @author Usama Uayyab (usamatayyab9@gmail.com)
  * @brief 
- * Compilation command : g++ -std=c++17 ./packet_decoder.cpp
+ * Compilation command : g++ -std=c++17 -O2 ./packet_decoder.cpp
  * Compiled with gcc version 9.4.0
  * Problem statement : https://adventofcode.com/2021/day/16
  * 
@@ -12,15 +12,30 @@
  * 
  * - A struct `PacketStructure` which stores info about a packet and sub-packets.
  * 
+ * - A class `BitReader` which reads bit fields straight from the hex decoded bytes.
+ * 
  * - A struct `PacketParser` for parsing hex string into packet structure.
  * 
  * - A function `SumOfVersionNumbers` which recursivley calculates the sum of version numbers
  * of all packets.
  * 
- * - A function `EvalulatePacket()` which recursively computes all packet operations based on their type
+ * - A function `EvalulatePacket()` which computes all packet operations based on their type.
+ * The tree is first flattened in post-order (`FlattenPacketTree()`) and then evaluated
+ * bottom-up into a flat value array, so every sub-packet is evaluated exactly once.
+ * 
+ * - A struct `StreamingEvaluator` which computes both answers in a single pass over the bits,
+ * keeping only the chain of open operator packets on an explicit stack.
  * 
  * Driver code:
  * - The program expects one additional argument which should be the input filename.
+ *   By default the streaming evaluator is used, `--tree` builds the packet tree instead:
+ *          a.out input.txt --tree
+ *   `--bytecode` compiles the packets into postfix bytecode (`CompileTransmission()`) and runs it
+ *   on a small stack machine (`RunBytecode()`); the bytecode can be saved and replayed later:
+ *          a.out input.txt --bytecode --save input.bc
+ *          a.out --load input.bc 1000
+ *   `--bench` instead of the filename times evaluation of deeply nested min/max packets:
+ *          a.out --bench
  * - Prints part 1 solution i.e. sum of version numbers of all packets
  * - Prints part 2 solution i.e. expression result of all packets.
  * @copyright Copyright (c) 2024
@@ -38,7 +53,12 @@
 #include <numeric>
 #include <optional>
 #include <charconv>
+#include <system_error>
 #include <stack>
+#include <cstdint>
+#include <stdexcept>
+#include <chrono>
+#include <functional>
 
 using namespace std;
 
@@ -88,6 +108,77 @@ StreamType& operator<<(StreamType &out, const PacketStructure &packet_data)
     return out;
 }
 
+/**
+ * @brief Converts a hex string into raw bytes, two hex digits per byte.
+ * An odd trailing digit becomes the high nibble of the last byte.
+ * @param hex_data 
+ * @return vector<uint8_t> 
+ * @throws invalid_argument on a non hex character
+ */
+vector<uint8_t> HexToBytes(string_view hex_data)
+{
+    const auto HexValue = [](char ch) -> uint8_t {
+        if ('0' <= ch && ch <= '9') { return ch - '0';      }
+        if ('A' <= ch && ch <= 'F') { return ch - 'A' + 10; }
+        if ('a' <= ch && ch <= 'f') { return ch - 'a' + 10; }
+        throw invalid_argument{ string{ "invalid hex digit: " } + ch };
+    };
+    auto bytes = vector<uint8_t>((size(hex_data) + 1) / 2);
+    for (auto idx = size_t{ 0 }; idx < size(hex_data); ++idx)
+    {
+        bytes[idx / 2] |= HexValue(hex_data[idx]) << (idx % 2 == 0 ? 4 : 0);
+    }
+    return bytes;
+}
+
+/**
+ * @brief Reads big-endian bit fields of up to 56 bits from a byte buffer.
+ * Bytes are shifted into a 64-bit buffer as needed, so a read is a shift
+ * and a mask instead of a string slice and a base 2 conversion.
+ */
+class BitReader
+{
+    public:
+    static constexpr auto kMaxReadBits = 56u;
+
+    explicit BitReader(vector<uint8_t> bytes) : bytes{ std::move(bytes) } { }
+
+    /**
+     * @brief Returns the next {nbits} bits as an unsigned number, first bit most significant.
+     * @throws out_of_range if the transmission ends before {nbits} bits
+     */
+    uint64_t Read(unsigned nbits)
+    {
+        if (nbits > kMaxReadBits) { throw invalid_argument{ "BitReader::Read: too many bits" }; }
+        if (buffered_bits < nbits) { Refill(); }
+        if (buffered_bits < nbits) { throw out_of_range{ "BitReader::Read: transmission is truncated" }; }
+        buffered_bits -= nbits;
+        position      += nbits;
+        return (buffer >> buffered_bits) & ((uint64_t{ 1 } << nbits) - 1);
+    }
+
+    /**
+     * @brief Number of bits read so far
+     */
+    size_t Position() const { return position; }
+
+    private:
+    void Refill()
+    {
+        while (buffered_bits <= 64 - 8 && next_byte < size(bytes))
+        {
+            buffer         = (buffer << 8) | bytes[next_byte++];
+            buffered_bits += 8;
+        }
+    }
+
+    vector<uint8_t> bytes;
+    size_t   next_byte{ 0 };
+    uint64_t buffer{ 0 };       //low {buffered_bits} bits are not read yet
+    unsigned buffered_bits{ 0 };
+    size_t   position{ 0 };
+};
+
 /**
  * @brief Structure for parsing packet string
  * Function operator overload is provided should be called
@@ -101,117 +192,60 @@ struct PacketParser
     static constexpr auto kLiteralTypeId  = 4;
 
     /**
-     * @brief Converts the hex string to binary string and parses the binary 
-     * string into PacketStructure
+     * @brief Decodes the hex string into bytes and parses the bits into PacketStructure
      * @param hex_data - string which contains hex data 
      * @return Parsed Packet
      */
     PacketStructure operator()(const string &hex_data)
     {
-        const auto kBinaryData         = ConvertHexStringToBitString(hex_data);
-        auto [packets, bits_processed] = ExtractPacket_REC(kBinaryData);
-        return packets;
+        auto reader = BitReader{ HexToBytes(hex_data) };
+        return ExtractPacket_REC(reader);
     }
 
     /**
-     * @brief Replaces each character in the string param hex_data with its binary
-     * equivalent. Binary of each character is confined to 4 bits.
-     * @param hex_data 
-     * @return Binar representation on hex string
-     */
-    string ConvertHexStringToBitString(const string &hex_data)
-    {
-        static const auto kHexToBinaryUmap = std::unordered_map<char, string_view>
-        {
-            {'0', "0000"}, {'1', "0001"}, {'2', "0010"}, {'3', "0011"},
-            {'4', "0100"}, {'5', "0101"}, {'6', "0110"}, {'7', "0111"},
-            {'8', "1000"}, {'9', "1001"}, {'A', "1010"}, {'B', "1011"},
-            {'C', "1100"}, {'D', "1101"}, {'E', "1110"}, {'F', "1111"}
-        };
-        auto binary_data = string{};
-        for (const auto &kCh : hex_data)
-        {
-            binary_data.append(kHexToBinaryUmap.at(kCh));
-        }
-        return binary_data;
-    }
-
-    /**
-     * @brief Parses the bit string as per the rules and returns the Packet structure
+     * @brief Parses the next packet from the reader as per the rules and returns the Packet structure
      * which points to the root packet.
-     * @param binary_view 
-     * @return pair<PacketStructure, size_t> 
+     * @param reader 
+     * @return PacketStructure
      */
-    pair<PacketStructure, size_t> ExtractPacket_REC(string_view binary_view)
+    PacketStructure ExtractPacket_REC(BitReader &reader)
     {
-        const auto kVersion    = BinaryToDecimal(binary_view.substr(0, kVersionBitSize));//First 3 bits are version bits
-        const auto kTypeID     = BinaryToDecimal(binary_view.substr(3, kTypeIDBitSize));//Next 3 bits are representing typeID
+        const auto kVersion    = static_cast<long long int>(reader.Read(kVersionBitSize));//First 3 bits are version bits
+        const auto kTypeID     = static_cast<long long int>(reader.Read(kTypeIDBitSize));//Next 3 bits are representing typeID
         auto packets_structure = PacketStructure{kVersion, kTypeID};
-        auto bits_processed    = size_t{ kVersionBitSize + kTypeIDBitSize };
-        binary_view.remove_prefix(bits_processed);
         if (kLiteralTypeId == kTypeID)
         {
-            const auto kLiteralsGroups  = FetchLiteralGroups(binary_view);
-            packets_structure.literal   = ConvertLiteralGroups(kLiteralsGroups);
-            bits_processed             += accumulate(cbegin(kLiteralsGroups), cend(kLiteralsGroups), size_t{ 0 },
-            [](const auto init, const auto literal_str){
-                return init + size(literal_str);
-            });
+            packets_structure.literal = ReadLiteral(reader);
         }
         else
         {
-            const auto kLengthTypeID = binary_view.front() - '0';
-            bits_processed          += 1;
-            binary_view.remove_prefix(1);
+            const auto kLengthTypeID = reader.Read(1);
             if (0 == kLengthTypeID)
             {
                 /**
                  * If the length type ID is 0, then the next 15 bits are a number that represents
                  * the total length in bits of the sub-packets contained by this packet
                  */
-                const auto kLengthOfSubPacketsInBits = BinaryToDecimal(binary_view.substr(0, 15));
-                bits_processed                      += 15;
-                binary_view.remove_prefix(15);
-                for (auto subpacket_bits = size_t{ 0 }; subpacket_bits < kLengthOfSubPacketsInBits ;)
+                const auto kLengthOfSubPacketsInBits = reader.Read(15);
+                const auto kEnd                      = reader.Position() + kLengthOfSubPacketsInBits;
+                while (reader.Position() < kEnd)
                 {
-                    const auto [kSubPackets, kSubPacketsBitsProcessed] = ExtractPacket_REC(binary_view);
-                    subpacket_bits += kSubPacketsBitsProcessed;
-                    bits_processed += kSubPacketsBitsProcessed;
-                    packets_structure.sub_packets.push_back(kSubPackets);
-                    binary_view.remove_prefix(kSubPacketsBitsProcessed);
+                    packets_structure.sub_packets.push_back(ExtractPacket_REC(reader));
                 }
             }
-            else if (1 == kLengthTypeID)
+            else
             {
                 /**If the length type ID is 1, then the next 11 bits are a number that represents
                  * the number of sub-packets immediately contained by this packet.
                 */
-                const auto kNumberOfSubPackets = BinaryToDecimal(binary_view.substr(0, 11));
-                bits_processed                += 11;
-                binary_view.remove_prefix(11);
+                const auto kNumberOfSubPackets = reader.Read(11);
                 for (auto sub_packets_extracted = size_t{ 0 }; sub_packets_extracted < kNumberOfSubPackets ;++sub_packets_extracted)
                 {
-                    const auto [kSubPackets, kSubPacketsBitsProcessed] = ExtractPacket_REC(binary_view);
-                    bits_processed          += kSubPacketsBitsProcessed;
-                    packets_structure.sub_packets.push_back(kSubPackets);
-                    binary_view.remove_prefix(kSubPacketsBitsProcessed);
+                    packets_structure.sub_packets.push_back(ExtractPacket_REC(reader));
                 }
             }
         }
-        return { packets_structure, bits_processed };
-    }
-
-    /**
-     * @brief Converts binary to decimal
-     * 
-     * @param data_view 
-     * @return long long int 
-     */
-    long long int BinaryToDecimal(string_view data_view)
-    {
-        long long int value{};
-        from_chars(data_view.cbegin(), data_view.cend(), value, 2);
-        return value;
+        return packets_structure;
     }
 
     /**
@@ -221,42 +255,18 @@ struct PacketParser
      * until its length is a multiple of four bits, and then it is broken into groups of
      * four bits. Each group is prefixed by a 1 bit except the last group, which is prefixed
      * by a 0 bit. These groups of five bits immediately follow the packet header
-     * @param binary_data 
-     * @return vector of literals such that padded character is part of each literals
-     * 
-     * @note padded character from each literal is not removed, it is caller's duty
-     * to remove the padded character before processing
+     * @param reader 
+     * @return long long int - value of the literal
      */
-    vector<string_view> FetchLiteralGroups(string_view binary_data)
+    static long long int ReadLiteral(BitReader &reader)
     {
-        auto literal_groups = vector<string_view>{};
-        auto first_value    = '\0';
+        auto value = uint64_t{ 0 };
+        auto group = uint64_t{ 0 };
         do {
-            first_value = binary_data.front();
-            literal_groups.push_back(string_view{ binary_data.data(), 5 });
-            binary_data.remove_prefix(5); //length of each group is 5
-        } while (first_value != '0');
-        return literal_groups;
-    }
-
-    /**
-     * @brief All the literals in the list param literal_groups are first flatten
-     * into a single string with padded character removed. Then converts string
-     * into decimal
-     * @param literal_groups 
-     * @return 
-     */
-    long long int ConvertLiteralGroups(const vector<string_view> &literal_groups)
-    {
-        auto literal_str = string{};
-        for (const auto &kLiteralSubGroup : literal_groups)
-        {
-            /**Each group is prefixed by a 1 bit except the last group, which is prefixed by a 0 bit. So therefore
-             * ignore first bit.
-            */
-            literal_str.append(cbegin(kLiteralSubGroup) + 1, cend(kLiteralSubGroup));
-        }
-        return BinaryToDecimal(literal_str);
+            group = reader.Read(5);//length of each group is 5
+            value = (value << 4) | (group & 0xF);
+        } while (group & 0x10);
+        return static_cast<long long int>(value);
     }
 };
 
@@ -274,84 +284,615 @@ size_t SumOfVersionNumbers(const PacketStructure &packets)
 }
 
 /**
- * @brief Evaluates the packet tree structure and returns the final value
+ * @brief Packet tree flattened in post-order: every sub-packet is stored before
+ * its parent and the root is the last node. The sub-packets of node i are
+ * child_indices[child_begin[i] ... child_begin[i + 1]).
+ */
+struct FlatPacketTree
+{
+    vector<long long int> versions;
+    vector<long long int> typeIDs;
+    vector<size_t> literals;   //literal value, 0 for operator packets
+    vector<size_t> child_begin;//one more entry than nodes
+    vector<size_t> child_indices;
+
+    size_t NodeCount() const { return size(typeIDs); }
+};
+
+/**
+ * @brief Flattens the packet tree without recursion, see FlatPacketTree.
+ * @param packets - Root packet
+ * @return FlatPacketTree
+ */
+FlatPacketTree FlattenPacketTree(const PacketStructure &packets)
+{
+    struct Frame
+    {
+        const PacketStructure *packet;
+        size_t next_child;
+        size_t pending_begin;//where this packet's finished children start in {pending}
+    };
+    auto tree    = FlatPacketTree{};
+    auto frames  = vector<Frame>{ { &packets, 0, 0 } };
+    auto pending = vector<size_t>{};//node indices of finished children of open frames
+    tree.child_begin.push_back(0);
+    while (!frames.empty())
+    {
+        auto &frame = frames.back();
+        if (frame.next_child < size(frame.packet->sub_packets))
+        {
+            const auto kChild = &frame.packet->sub_packets[frame.next_child++];
+            frames.push_back(Frame{ kChild, 0, size(pending) });
+            continue;
+        }
+        tree.versions.push_back(frame.packet->version);
+        tree.typeIDs.push_back(frame.packet->typeID);
+        tree.literals.push_back(static_cast<size_t>(frame.packet->literal.value_or(0)));
+        tree.child_indices.insert(cend(tree.child_indices), cbegin(pending) + frame.pending_begin, cend(pending));
+        tree.child_begin.push_back(size(tree.child_indices));
+        pending.resize(frame.pending_begin);
+        pending.push_back(tree.NodeCount() - 1);
+        frames.pop_back();
+    }
+    return tree;
+}
+
+/**
+ * @brief Evaluates a flattened packet tree bottom-up. Since sub-packets precede their
+ * parent, one forward pass computes every node's value exactly once into a flat array.
+ * @param tree 
+ * @return size_t - value of the root packet
+ */
+size_t EvaluateFlatPacketTree(const FlatPacketTree &tree)
+{
+    auto values = vector<size_t>(tree.NodeCount());
+    for (auto node = size_t{ 0 }; node < tree.NodeCount(); ++node)
+    {
+        const auto kBegin = cbegin(tree.child_indices) + tree.child_begin[node];
+        const auto kEnd   = cbegin(tree.child_indices) + tree.child_begin[node + 1];
+        const auto Value  = [&](size_t child_idx){ return values[child_idx]; };
+        auto return_value = size_t{};
+        switch (tree.typeIDs[node])
+        {
+            case 4 : { return_value = tree.literals[node]; break; }
+            case 0 : {
+                /**
+                 * Packets with type ID 0 are sum packets - their value is the sum of the values of their sub-packets.
+                 * If they only have a single sub-packet, their value is the value of the sub-packet.
+                */
+                return_value = accumulate(kBegin, kEnd, size_t{ 0 }, [&](const auto init, size_t child){ return init + Value(child); });
+                break;
+            }
+            case 1 : {
+                /**Packets with type ID 1 are product packets - their value is the result of multiplying together 
+                 * the values of their sub-packets. If they only have a single sub-packet, their value is the value
+                 * of the sub-packet.
+                 **/
+                return_value = accumulate(kBegin, kEnd, size_t{ 1 }, [&](const auto init, size_t child){ return init * Value(child); });
+                break;
+            }
+            case 2 : { 
+                /*!Packets with type ID 2 are minimum packets - their value is the minimum of the values of their sub-packets.*/
+                return_value = Value(*min_element(kBegin, kEnd, [&](size_t c1, size_t c2){ return Value(c1) < Value(c2); }));
+                break;
+            }
+            case 3 : {
+                /*!Packets with type ID 3 are maximum packets - their value is the maximum of the values of their sub-packets.*/
+                return_value = Value(*max_element(kBegin, kEnd, [&](size_t c1, size_t c2){ return Value(c1) < Value(c2); }));
+                break;
+            }
+            case 5 : {
+                /*!Packets with type ID 5 are greater than packets - their value is 1 if the value of the
+                first sub-packet is greater than the value of the second sub-packet; otherwise, their
+                value is 0. These packets always have exactly two sub-packets.*/
+                return_value = Value(kBegin[0]) > Value(kBegin[1]);
+                break;
+            }
+            case 6 : {
+                /*!Packets with type ID 6 are less than packets - their value is 1 if the value of the
+                first sub-packet is less than the value of the second sub-packet; otherwise, their
+                value is 0. These packets always have exactly two sub-packets.*/
+                return_value = Value(kBegin[0]) < Value(kBegin[1]);
+                break;
+            }
+            case 7 : {
+                /*!Packets with type ID 7 are equal to packets - their value is 1 if the value of the
+                first sub-packet is equal to the value of the second sub-packet; otherwise, their
+                value is 0. These packets always have exactly two sub-packets.*/
+                return_value = Value(kBegin[0]) == Value(kBegin[1]);
+                break;
+            }
+
+            default : { break; }
+        }
+        values[node] = return_value;
+    }
+    return values.empty() ? 0 : values.back();
+}
+
+/**
+ * @brief Evaluates the packet tree structure and returns the final value.
+ * The tree is flattened first so that each sub-packet is evaluated exactly once;
+ * evaluating it directly with min_element/max_element comparators would re-evaluate
+ * sub-packets on every comparison, which is exponential in the nesting depth.
  * @param packets 
  * @return 
  */
 size_t EvalulatePacket(const PacketStructure &packets)
 {
-    constexpr auto PacketComparator = [](const PacketStructure &p1, const PacketStructure &p2){
-        return EvalulatePacket(p1) < EvalulatePacket(p2);
+    return EvaluateFlatPacketTree(FlattenPacketTree(packets));
+}
+
+/**
+ * @brief One bytecode instruction: a literal (typeID 4) or an operator applied to the
+ * top {child_count} values of the stack. The version is kept for Part 1.
+ */
+struct Instruction
+{
+    uint8_t  typeID;
+    uint8_t  version;
+    uint32_t child_count;
+    uint64_t literal;
+};
+
+/**
+ * @brief A transmission lowered into postfix order: sub-packets precede the operator
+ * that consumes them, so it can be evaluated with a plain value stack.
+ */
+struct PacketBytecode
+{
+    vector<Instruction> code;
+    size_t max_stack_depth{ 0 };
+};
+
+/**
+ * @brief Checks that every operator finds enough operands, that comparisons have exactly two
+ * and that exactly one value is left. Returns the maximum stack depth.
+ * @throws invalid_argument on malformed bytecode
+ */
+size_t ValidateBytecode(const vector<Instruction> &code)
+{
+    auto depth     = size_t{ 0 };
+    auto max_depth = size_t{ 0 };
+    for (const auto &kInstruction : code)
+    {
+        if (kInstruction.typeID > 7) { throw invalid_argument{ "bytecode: unknown type ID" }; }
+        if (PacketParser::kLiteralTypeId != kInstruction.typeID)
+        {
+            const auto kIsComparison = kInstruction.typeID >= 5;
+            if (0 == kInstruction.child_count || (kIsComparison && 2 != kInstruction.child_count))
+            {
+                throw invalid_argument{ "bytecode: bad operand count" };
+            }
+            if (kInstruction.child_count > depth) { throw invalid_argument{ "bytecode: stack underflow" }; }
+            depth -= kInstruction.child_count;
+        }
+        max_depth = std::max(max_depth, ++depth);
+    }
+    if (1 != depth) { throw invalid_argument{ "bytecode: must leave exactly one value" }; }
+    return max_depth;
+}
+
+/**
+ * @brief Lowers a flattened packet tree into bytecode; its post-order is already postfix.
+ * @param tree 
+ * @return PacketBytecode
+ */
+PacketBytecode LowerToBytecode(const FlatPacketTree &tree)
+{
+    auto bytecode = PacketBytecode{};
+    bytecode.code.reserve(tree.NodeCount());
+    for (auto node = size_t{ 0 }; node < tree.NodeCount(); ++node)
+    {
+        bytecode.code.push_back(Instruction{ static_cast<uint8_t>(tree.typeIDs[node]), static_cast<uint8_t>(tree.versions[node]),
+                                             static_cast<uint32_t>(tree.child_begin[node + 1] - tree.child_begin[node]),
+                                             tree.literals[node] });
+    }
+    bytecode.max_stack_depth = ValidateBytecode(bytecode.code);
+    return bytecode;
+}
+
+/**
+ * @brief Parses a hex transmission straight into bytecode without building a tree.
+ * Like StreamingEvaluator, the operators whose sub-packets are still being read
+ * are kept on an explicit stack, so any nesting depth compiles; an operator is
+ * emitted as soon as its last sub-packet has been emitted.
+ */
+PacketBytecode CompileTransmission(const string &hex_data)
+{
+    struct OpenOperator
+    {
+        uint8_t  typeID;
+        uint8_t  version;
+        bool     limit_in_bits;//length type ID 0: {limit} is the end bit position, else the sub-packet count
+        size_t   limit;
+        uint32_t children{ 0 };
+    };
+    auto reader   = BitReader{ HexToBytes(hex_data) };
+    auto bytecode = PacketBytecode{};
+    auto open     = vector<OpenOperator>{};
+    const auto IsComplete = [&reader](const OpenOperator &op) {
+        return op.limit_in_bits ? reader.Position() >= op.limit : op.children >= op.limit;
     };
-    auto return_value = size_t{};
-    switch (packets.typeID)
+    do
     {
-        case 4 : { return_value = packets.literal.value(); break; }
-        case 0 : {
-            /**
-             * Packets with type ID 0 are sum packets - their value is the sum of the values of their sub-packets.
-             * If they only have a single sub-packet, their value is the value of the sub-packet.
-            */
-            return_value = accumulate(cbegin(packets.sub_packets), cend(packets.sub_packets), size_t{ 0 }, 
-            [](const auto init, const PacketStructure &sub_packet){
-                return init + EvalulatePacket(sub_packet);
-            });
-            break;
+        const auto kVersion = static_cast<uint8_t>(reader.Read(PacketParser::kVersionBitSize));
+        const auto kTypeID  = static_cast<uint8_t>(reader.Read(PacketParser::kTypeIDBitSize));
+        if (PacketParser::kLiteralTypeId == kTypeID)
+        {
+            const auto kLiteral = static_cast<uint64_t>(PacketParser::ReadLiteral(reader));
+            bytecode.code.push_back(Instruction{ kTypeID, kVersion, 0, kLiteral });
+            if (!open.empty()) { ++open.back().children; }
         }
-        case 1 : {
-            /**Packets with type ID 1 are product packets - their value is the result of multiplying together 
-             * the values of their sub-packets. If they only have a single sub-packet, their value is the value
-             * of the sub-packet.
-             **/
-            return_value = accumulate(cbegin(packets.sub_packets), cend(packets.sub_packets), size_t{ 1 }, 
-            [](const auto init, const PacketStructure &sub_packet){
-                return init * EvalulatePacket(sub_packet);
-            });
-            break;
+        else
+        {
+            const auto kLengthInBits = 0 == reader.Read(1);
+            const auto kLengthField  = static_cast<size_t>(reader.Read(kLengthInBits ? 15 : 11));
+            const auto kLimit        = kLengthInBits ? reader.Position() + kLengthField : kLengthField;
+            open.push_back(OpenOperator{ kTypeID, kVersion, kLengthInBits, kLimit });
         }
-        case 2 : { 
-            /*!Packets with type ID 2 are minimum packets - their value is the minimum of the values of their sub-packets.*/
-            return_value = EvalulatePacket(*min_element(cbegin(packets.sub_packets), cend(packets.sub_packets), PacketComparator));
-            break;
+        while (!open.empty() && IsComplete(open.back()))
+        {
+            const auto kDone = open.back();
+            open.pop_back();
+            bytecode.code.push_back(Instruction{ kDone.typeID, kDone.version, kDone.children, 0 });
+            if (!open.empty()) { ++open.back().children; }
         }
-        case 3 : {
-            /*!Packets with type ID 3 are maximum packets - their value is the maximum of the values of their sub-packets.*/
-            return_value = EvalulatePacket(*max_element(cbegin(packets.sub_packets), cend(packets.sub_packets), PacketComparator));
-            break;
+    } while (!open.empty());
+    bytecode.max_stack_depth = ValidateBytecode(bytecode.code);
+    return bytecode;
+}
+
+/**
+ * @brief Evaluates validated bytecode with a switch-dispatched loop over a preallocated value stack.
+ * @param bytecode 
+ * @return size_t - value of the transmission
+ */
+size_t RunBytecode(const PacketBytecode &bytecode)
+{
+    auto stack = vector<size_t>(bytecode.max_stack_depth);
+    auto top   = stack.data();//one past the last value
+    for (const auto &kInstruction : bytecode.code)
+    {
+        const auto kOperands = top - kInstruction.child_count;
+        auto value = size_t{};
+        switch (kInstruction.typeID)
+        {
+            case 4 : { *top++ = kInstruction.literal; continue; }
+            case 0 : { value = std::accumulate(kOperands, top, size_t{ 0 }); break; }
+            case 1 : { value = std::accumulate(kOperands, top, size_t{ 1 }, std::multiplies<size_t>{}); break; }
+            case 2 : { value = *std::min_element(kOperands, top); break; }
+            case 3 : { value = *std::max_element(kOperands, top); break; }
+            case 5 : { value = kOperands[0] >  kOperands[1]; break; }
+            case 6 : { value = kOperands[0] <  kOperands[1]; break; }
+            case 7 : { value = kOperands[0] == kOperands[1]; break; }
+            default : { break; }
         }
-        case 5 : {
-            /*!Packets with type ID 5 are greater than packets - their value is 1 if the value of the
-            first sub-packet is greater than the value of the second sub-packet; otherwise, their
-            value is 0. These packets always have exactly two sub-packets.*/
-            return_value = EvalulatePacket(packets.sub_packets[0]) > EvalulatePacket(packets.sub_packets[1]);
-            break;
+        top  = kOperands;
+        *top++ = value;
+    }
+    return stack.front();
+}
+
+/**
+ * @brief Sum of the version numbers of all packets in the bytecode
+ */
+size_t BytecodeVersionSum(const PacketBytecode &bytecode)
+{
+    return accumulate(cbegin(bytecode.code), cend(bytecode.code), size_t{ 0 },
+        [](const auto init, const Instruction &instruction){ return init + instruction.version; });
+}
+
+/**
+ * @brief Binary bytecode file: the magic "PKTBC01\n", the instruction count as 8 bytes and
+ * then 14 bytes per instruction (typeID, version, 4 byte child count, 8 byte literal).
+ * Multi-byte fields are little-endian regardless of the host.
+ */
+constexpr auto kBytecodeMagic = string_view{ "PKTBC01\n" };
+
+void SaveBytecode(const PacketBytecode &bytecode, const string &filename)
+{
+    const auto WriteLE = [](ostream &out, uint64_t value, size_t byte_count) {
+        for (auto idx = size_t{ 0 }; idx < byte_count; ++idx) { out.put(static_cast<char>((value >> (8 * idx)) & 0xFF)); }
+    };
+    auto fout = ofstream{ filename, ios::binary };
+    fout.write(kBytecodeMagic.data(), size(kBytecodeMagic));
+    WriteLE(fout, size(bytecode.code), 8);
+    for (const auto &kInstruction : bytecode.code)
+    {
+        WriteLE(fout, kInstruction.typeID, 1);
+        WriteLE(fout, kInstruction.version, 1);
+        WriteLE(fout, kInstruction.child_count, 4);
+        WriteLE(fout, kInstruction.literal, 8);
+    }
+    if (!fout) { throw runtime_error{ "could not write bytecode to " + filename }; }
+}
+
+/**
+ * @brief Reads a file written by SaveBytecode() and validates it.
+ * @throws runtime_error if the file is missing, truncated or not bytecode, invalid_argument if it is malformed
+ */
+PacketBytecode LoadBytecode(const string &filename)
+{
+    auto fin = ifstream{ filename, ios::binary };
+    const auto ReadLE = [&fin](size_t byte_count) {
+        auto value = uint64_t{ 0 };
+        for (auto idx = size_t{ 0 }; idx < byte_count; ++idx) { value |= uint64_t{ static_cast<uint8_t>(fin.get()) } << (8 * idx); }
+        if (!fin) { throw runtime_error{ "truncated bytecode file" }; }
+        return value;
+    };
+    auto magic = string(size(kBytecodeMagic), '\0');
+    if (!fin.read(magic.data(), size(magic)) || magic != kBytecodeMagic) { throw runtime_error{ filename + " is not a bytecode file" }; }
+    auto bytecode = PacketBytecode{};
+    const auto kCount = ReadLE(8);//not trusted for preallocation, a bogus count fails on truncation instead
+    for (auto idx = uint64_t{ 0 }; idx < kCount; ++idx)
+    {
+        auto instruction        = Instruction{};
+        instruction.typeID      = static_cast<uint8_t>(ReadLE(1));
+        instruction.version     = static_cast<uint8_t>(ReadLE(1));
+        instruction.child_count = static_cast<uint32_t>(ReadLE(4));
+        instruction.literal     = ReadLE(8);
+        bytecode.code.push_back(instruction);
+    }
+    bytecode.max_stack_depth = ValidateBytecode(bytecode.code);
+    return bytecode;
+}
+
+/**
+ * @brief Result of evaluating a transmission
+ */
+struct TransmissionSummary
+{
+    size_t version_sum{ 0 };
+    size_t value{ 0 };
+};
+
+/**
+ * @brief Evaluates a transmission while parsing it, without building a PacketStructure tree.
+ * Every operator packet whose sub-packets are still being read is kept on an explicit
+ * stack together with its running value, so memory is O(nesting depth) and arbitrarily
+ * deep transmissions cannot overflow the call stack. When a packet's value is known it
+ * is folded into the operator on top of the stack; an operator whose sub-packets are
+ * exhausted is popped and its value folded into its own parent in turn.
+ */
+struct StreamingEvaluator
+{
+    /**
+     * @brief An operator packet whose sub-packets are still being read
+     */
+    struct OperatorFrame
+    {
+        long long int typeID;
+        bool   limit_in_bits;//length type ID 0: {limit} is the end bit position, else the sub-packet count
+        size_t limit;
+        size_t children{ 0 };
+        size_t value{ 0 };
+
+        bool IsComplete(const BitReader &reader) const
+        {
+            return limit_in_bits ? reader.Position() >= limit : children >= limit;
+        }
+
+        void Fold(size_t sub_value)
+        {
+            switch (typeID)
+            {
+                case 0 : { value += sub_value; break; }
+                case 1 : { value  = (0 == children) ? sub_value : value * sub_value; break; }
+                case 2 : { value  = (0 == children) ? sub_value : std::min(value, sub_value); break; }
+                case 3 : { value  = (0 == children) ? sub_value : std::max(value, sub_value); break; }
+                //Comparisons keep the first operand in {value} until the second arrives
+                case 5 : { value  = (0 == children) ? sub_value : value >  sub_value; break; }
+                case 6 : { value  = (0 == children) ? sub_value : value <  sub_value; break; }
+                case 7 : { value  = (0 == children) ? sub_value : value == sub_value; break; }
+                default : { break; }
+            }
+            ++children;
         }
-        case 6 : {
-            /*!Packets with type ID 6 are less than packets - their value is 1 if the value of the
-            first sub-packet is less than the value of the second sub-packet; otherwise, their
-            value is 0. These packets always have exactly two sub-packets.*/
-            return_value = EvalulatePacket(packets.sub_packets[0]) < EvalulatePacket(packets.sub_packets[1]);
-            break;
+    };
+
+    TransmissionSummary operator()(const string &hex_data)
+    {
+        auto reader = BitReader{ HexToBytes(hex_data) };
+        return Evaluate(reader);
+    }
+
+    /**
+     * @brief Evaluates the outermost packet in the reader
+     * @param reader 
+     * @return TransmissionSummary
+     */
+    TransmissionSummary Evaluate(BitReader &reader)
+    {
+        auto summary = TransmissionSummary{};
+        auto frames  = vector<OperatorFrame>{};
+        while (true)
+        {
+            summary.version_sum += reader.Read(PacketParser::kVersionBitSize);
+            const auto kTypeID   = static_cast<long long int>(reader.Read(PacketParser::kTypeIDBitSize));
+            auto value           = size_t{ 0 };
+            if (PacketParser::kLiteralTypeId == kTypeID)
+            {
+                value = static_cast<size_t>(PacketParser::ReadLiteral(reader));
+            }
+            else
+            {
+                const auto kLengthInBits = 0 == reader.Read(1);
+                const auto kLengthField  = static_cast<size_t>(reader.Read(kLengthInBits ? 15 : 11));
+                const auto kLimit        = kLengthInBits ? reader.Position() + kLengthField : kLengthField;
+                frames.push_back(OperatorFrame{ kTypeID, kLengthInBits, kLimit });
+                if (!frames.back().IsComplete(reader)) { continue; }
+                value = frames.back().value;//operator without sub-packets
+                frames.pop_back();
+            }
+            //Fold the finished packet into its parents, popping every parent it completes
+            while (true)
+            {
+                if (frames.empty())
+                {
+                    summary.value = value;
+                    return summary;
+                }
+                auto &parent = frames.back();
+                parent.Fold(value);
+                if (!parent.IsComplete(reader)) { break; }
+                value = parent.value;
+                frames.pop_back();
+            }
         }
-        case 7 : {
-            /*!Packets with type ID 7 are equal to packets - their value is 1 if the value of the
-            first sub-packet is equal to the value of the second sub-packet; otherwise, their
-            value is 0. These packets always have exactly two sub-packets.*/
-            return_value = EvalulatePacket(packets.sub_packets[0]) == EvalulatePacket(packets.sub_packets[1]);
-            break;
+    }
+};
+
+/**
+ * @brief Writes big-endian bit fields and renders them as a hex string, the inverse of BitReader.
+ */
+class BitWriter
+{
+    public:
+    void Write(uint64_t value, unsigned nbits)
+    {
+        for (auto bit = nbits; bit-- > 0;)
+        {
+            if (0 == bit_count % 8) { bytes.push_back(0); }
+            bytes.back() |= ((value >> bit) & 1) << (7 - bit_count % 8);
+            ++bit_count;
         }
+    }
 
-        default : { break; }
+    string ToHex() const
+    {
+        static constexpr auto kHexDigits = string_view{ "0123456789ABCDEF" };
+        auto hex = string{};
+        hex.reserve(2 * size(bytes));
+        for (const auto &kByte : bytes) { hex.push_back(kHexDigits[kByte >> 4]); hex.push_back(kHexDigits[kByte & 0xF]); }
+        return hex;
     }
-    return return_value;
+
+    private:
+    vector<uint8_t> bytes;
+    size_t bit_count{ 0 };
+};
+
+/**
+ * @brief Builds a transmission of {depth} nested minimum/maximum packets (alternating).
+ * Each has two sub-packets: the next nested packet and a literal that always loses
+ * against it. This is the worst case for evaluating min/max by re-evaluating the
+ * winning sub-packet after the comparator: the work doubles with every level.
+ * @param depth 
+ * @return string - hex transmission
+ */
+string MakeNestedMinMaxTransmission(size_t depth)
+{
+    auto writer = BitWriter{};
+    for (auto level = size_t{ 0 }; level < depth; ++level)
+    {
+        writer.Write(level % 8, PacketParser::kVersionBitSize);
+        writer.Write(level % 2 ? 3 : 2, PacketParser::kTypeIDBitSize);
+        writer.Write(1, 1); //length type ID 1
+        writer.Write(2, 11);//two sub-packets
+    }
+    const auto WriteLiteral = [&](uint64_t value) {
+        writer.Write(0, PacketParser::kVersionBitSize);
+        writer.Write(PacketParser::kLiteralTypeId, PacketParser::kTypeIDBitSize);
+        writer.Write(value, 5);//single group, value < 16
+    };
+    WriteLiteral(7);
+    //The nested value stays 7, so it beats 15 in every minimum and 0 in every maximum
+    for (auto level = depth; level-- > 0;) { WriteLiteral(level % 2 ? 0 : 15); }
+    return writer.ToHex();
 }
 
-int main(int argc, const char *args[])
+/**
+ * @brief Times tree parsing, flat bottom-up evaluation and streaming evaluation on
+ * nested min/max transmissions of doubling depth; the time per packet should stay flat.
+ */
+void RunNestedMinMaxBenchmark()
 {
-    auto data    = ReadInput(args[1]);
-    auto packets = PacketParser{}(data);
+    using Clock = std::chrono::steady_clock;
+    const auto kMs = [](Clock::duration d){ return std::chrono::duration<double, std::milli>(d).count(); };
+    //Parsing into PacketStructure is still recursive, so the depth stays well within the call stack
+    for (auto depth = size_t{ 1'000 }; depth <= 16'000; depth *= 2)
+    {
+        const auto kData    = MakeNestedMinMaxTransmission(depth);
+        auto start          = Clock::now();
+        const auto kPackets = PacketParser{}(kData);
+        const auto kParseMs = kMs(Clock::now() - start);
+        start               = Clock::now();
+        const auto kValue   = EvalulatePacket(kPackets);
+        const auto kEvalMs  = kMs(Clock::now() - start);
+        start               = Clock::now();
+        const auto kStream  = StreamingEvaluator{}(kData);
+        const auto kStreamMs = kMs(Clock::now() - start);
+        const auto kBytecode = LowerToBytecode(FlattenPacketTree(kPackets));
+        start               = Clock::now();
+        const auto kVMValue = RunBytecode(kBytecode);
+        const auto kVMMs    = kMs(Clock::now() - start);
+        const auto kPacketCount = 2 * depth + 1;
+        cout << "depth " << depth << ": value " << kValue << " / " << kStream.value << " / " << kVMValue
+             << ", parse " << kParseMs << " ms, evaluate " << kEvalMs << " ms ("
+             << 1e6 * kEvalMs / kPacketCount << " ns/packet), streaming " << kStreamMs << " ms, bytecode "
+             << kVMMs << " ms (" << 1e6 * kVMMs / kPacketCount << " ns/packet)\n";
+    }
+}
 
-    cout << "Part 1(Sum of version numbers): " << SumOfVersionNumbers(packets) << endl;
-    cout << "Part 2(Expression value)      : " << EvalulatePacket(packets) << endl;
+/**
+ * @brief Parses a whole argument as an unsigned count; nullopt if it is not one.
+ */
+optional<unsigned long> ParseCount(string_view str)
+{
+    auto count = 0ul;
+    const auto [ptr, ec] = from_chars(str.data(), str.data() + str.size(), count);
+    if (ec != errc{} || ptr != str.data() + str.size() || str.empty()) { return nullopt; }
+    return count;
+}
+
+int main(int argc, const char *args[])
+{
+    const auto kUsage = [&]{
+        cout << "usage: " << args[0] << " <input file> [--tree | --bytecode [--save file]] | --load file [replays] | --bench\n";
+        return 1;
+    };
+    if (argc < 2) { return kUsage(); }
+    const auto kFirstArg = string_view{ args[1] };
+    if (kFirstArg == "--bench")
+    {
+        RunNestedMinMaxBenchmark();
+        return 0;
+    }
+    if (kFirstArg == "--load" && argc > 2)
+    {
+        const auto kReplays = argc > 3 ? ParseCount(args[3]) : optional{ 1ul };
+        if (!kReplays) { return kUsage(); }
+        const auto kBytecode = LoadBytecode(args[2]);
+        using Clock = std::chrono::steady_clock;
+        const auto kStart = Clock::now();
+        auto value        = size_t{ 0 };
+        for (auto replay = 0ul; replay < *kReplays; ++replay) { value = RunBytecode(kBytecode); }
+        const auto kMs = std::chrono::duration<double, std::milli>(Clock::now() - kStart).count();
+        cout << "Part 1(Sum of version numbers): " << BytecodeVersionSum(kBytecode) << endl;
+        cout << "Part 2(Expression value)      : " << value << endl;
+        cout << *kReplays << " replays of " << size(kBytecode.code) << " instructions in " << kMs << " ms\n";
+        return 0;
+    }
+    const auto kData = ReadInput(args[1]);
+    const auto kMode = argc > 2 ? string_view{ args[2] } : string_view{};
+    if (kMode == "--tree")
+    {
+        const auto kPackets = PacketParser{}(kData);
+        cout << "Part 1(Sum of version numbers): " << SumOfVersionNumbers(kPackets) << endl;
+        cout << "Part 2(Expression value)      : " << EvalulatePacket(kPackets) << endl;
+        return 0;
+    }
+    if (kMode == "--bytecode")
+    {
+        const auto kBytecode = CompileTransmission(kData);
+        cout << "Part 1(Sum of version numbers): " << BytecodeVersionSum(kBytecode) << endl;
+        cout << "Part 2(Expression value)      : " << RunBytecode(kBytecode) << endl;
+        if (argc > 4 && string_view{ args[3] } == "--save") { SaveBytecode(kBytecode, args[4]); }
+        return 0;
+    }
+    const auto [kVersionSum, kValue] = StreamingEvaluator{}(kData);
+    cout << "Part 1(Sum of version numbers): " << kVersionSum << endl;
+    cout << "Part 2(Expression value)      : " << kValue << endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -1,18 +1,22 @@
 /**
  * @file squid.cpp
  * @author Usama Tayyab (usamatayyab9@gmail.com)
- * @brief 
+ * @brief
  * This code is the solution of @link https://adventofcode.com/2021/day/4 @endlink
- * The following is compiled on g++ version 9.4.0. 
- * Compilation command : g++ -std=c++17 squid.cpp
- * The program takes input the name of file as command line argument.
+ * The following is compiled on g++ version 9.4.0.
+ * Compilation command : g++ -std=c++17 -O2 squid.cpp
+ * The program takes input the name of file as command line argument,
+ * optionally followed by the board dimension N (defaults to 5).
  * For example if a.out is the binary obtained by compiling this program,
  * then it should be run as:
- *                  a.out test.txt
  *                  a.out input.txt
+ *                  a.out input.txt 10
+ * Passing --bench instead of a file name runs the engine on randomly
+ * generated tournaments with N = 5, 10 and 32:
+ *                  a.out --bench
  * @date 2022-01-11
  * @copyright Copyright (c) 2022
- */ 
+ */
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -22,6 +26,12 @@
 #include <sstream>
 #include <functional>
 #include <numeric>
+#include <unordered_map>
+#include <string_view>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <system_error>
 using namespace std;
 
 vector<int> ParseCSV(string str)
@@ -31,136 +41,192 @@ vector<int> ParseCSV(string str)
     return {istream_iterator<int>{ss}, istream_iterator<int>{}};
 }
 
-using Grid = vector<vector<int>>;
-
-void Read_N_SizeGrid(istream &in, Grid &grid, int N = 5)
+/**
+ * @brief
+ * All boards stored back to back in one contiguous buffer.
+ * Cell (row, col) of board b lives at cells[b * N * N + row * N + col].
+ */
+struct Boards
 {
-    grid.clear();
-    grid.assign(N, vector<int>(N, 0));
-    for (auto &vec : grid)
-    {
-        copy_n(istream_iterator<int>{in}, N, begin(vec));
-    }
-}
+    size_t N{5};
+    vector<int> cells;
 
-void print(const Grid &g)
+    size_t Count() const { return N == 0 ? 0 : cells.size() / (N * N); }
+};
+
+/**
+ * @brief
+ * Reads every N x N board remaining in @arg in. A trailing partial board
+ * (e.g. caused by a truncated file) is discarded.
+ */
+Boards ReadBoards(istream &in, size_t N)
 {
-    for (const auto &vec : g)
-    {
-        copy(cbegin(vec), cend(vec), ostream_iterator<remove_reference_t<decltype(vec)>::value_type>{cout, " "});
-        cout << endl;
-    }
+    auto boards  = Boards{N, {istream_iterator<int>{in}, istream_iterator<int>{}}};
+    boards.cells.resize(boards.Count() * N * N);
+    return boards;
 }
 
 struct BingoResult
 {
     long idx;
     int last_num_called;
+    long unmarked_sum{0};
 };
 
-void MarkGrid(Grid &g, const int num)
+struct BingoOutcome
 {
-    for (auto &vec : g)
+    BingoResult first_winner;
+    BingoResult last_winner;
+};
+
+/**
+ * @brief
+ * Plays bingo over all boards in a single pass through the drawn numbers.
+ * An index from number to every (board, cell) holding that number is built
+ * once, so a draw only touches the boards that actually contain it. Each
+ * board keeps one hit counter per row and per column; a board wins the
+ * moment one of its counters reaches N, so no rescanning of rows/columns
+ * is ever needed. Total cost is O(cells + draws) instead of
+ * O(draws * boards * N * N).
+ */
+class BingoEngine
+{
+    public:
+    BingoEngine(const Boards &boards) : kBoardCount{boards.Count()}, kN{boards.N}
     {
-        replace(begin(vec), end(vec), num, -1);
+        row_hits.assign(kBoardCount * kN, 0);
+        col_hits.assign(kBoardCount * kN, 0);
+        marked.assign(kBoardCount * kN * kN, 0);
+        has_won.assign(kBoardCount, 0);
+        unmarked_sum.assign(kBoardCount, 0);
+        for (auto idx = size_t{0}; idx < boards.cells.size(); ++idx)
+        {
+            const auto kNum = boards.cells[idx];
+            number_index[kNum].push_back(idx);
+            unmarked_sum[idx / (kN * kN)] += kNum;
+        }
     }
-}
 
-bool HasGridWon(const Grid &g)
-{
-    auto rows_result = any_of(cbegin(g), cend(g), [](const auto &vec){ 
-        return all_of(cbegin(vec), cend(vec), bind(equal_to{}, -1, std::placeholders::_1));
-    });
-    auto cols_result = false;
-    if (rows_result == false)
+    /**
+     * @brief
+     * Draws numbers from @arg list until every board has won or the list
+     * is exhausted. Returns both the first and the last board to win.
+     * A board that never wins is reported with idx equal to the number of boards.
+     */
+    BingoOutcome Play(const vector<int> &list)
     {
-        for (size_t i{0}; i < g.size() ;++i)
+        auto outcome = BingoOutcome{{static_cast<long>(kBoardCount), -1}, {static_cast<long>(kBoardCount), -1}};
+        auto boards_remaining = kBoardCount;
+        for (auto elem_itr = cbegin(list); elem_itr != cend(list) && boards_remaining > 0; ++elem_itr)
         {
-            auto j = size_t{0};
-            for (j = 0; j < g.size() && g[j][i] == -1 ; ++j) { continue; }
-            if  (j == g.size())
+            const auto kNum = *elem_itr;
+            const auto pos  = number_index.find(kNum);
+            if (pos == cend(number_index)) { continue; }
+            for (const auto &idx : pos->second)
             {
-                cols_result = true;
-                break;
+                const auto kBoard = idx / (kN * kN);
+                const auto kCell  = idx % (kN * kN);
+                if (has_won[kBoard] || marked[idx]) { continue; }
+                marked[idx] = 1;
+                unmarked_sum[kBoard] -= kNum;
+                const auto kRowHits = ++row_hits[kBoard * kN + kCell / kN];
+                const auto kColHits = ++col_hits[kBoard * kN + kCell % kN];
+                if (kRowHits == kN || kColHits == kN)
+                {
+                    has_won[kBoard] = 1;
+                    const auto kResult = BingoResult{static_cast<long>(kBoard), kNum, unmarked_sum[kBoard]};
+                    if (boards_remaining == kBoardCount) { outcome.first_winner = kResult; }
+                    outcome.last_winner = kResult;
+                    --boards_remaining;
+                }
             }
         }
+        return outcome;
     }
-    return rows_result || cols_result;
-}
 
-BingoResult PlayBingo(vector<Grid> &grids, const vector<int> &list)
+    private:
+    const size_t kBoardCount;
+    const size_t kN;
+    unordered_map<int, vector<size_t>> number_index;//number -> flat indices into Boards::cells
+    vector<uint32_t> row_hits;//N counters per board
+    vector<uint32_t> col_hits;//N counters per board
+    vector<uint8_t>  marked;  //same layout as Boards::cells
+    vector<uint8_t>  has_won;
+    vector<long>     unmarked_sum;
+};
+
+/**
+ * @brief
+ * Generates {board_count} random N x N boards, each holding distinct numbers
+ * drawn from [0, 4 * N * N), and a draw list that is a shuffle of that range.
+ * Then times BingoEngine construction and play.
+ */
+void RunBenchmark(size_t N, size_t board_count)
 {
-    auto results = BingoResult{grids.size(), -1};
-    for (const auto &elem : list)
+    auto rng       = mt19937{42};
+    auto pool      = vector<int>(4 * N * N);
+    iota(begin(pool), end(pool), 0);
+    auto boards    = Boards{N, {}};
+    boards.cells.reserve(board_count * N * N);
+    for (auto board = size_t{0}; board < board_count; ++board)
     {
-        for_each(begin(grids), end(grids), [&elem] (Grid &g) { MarkGrid(g, elem); });
-        if (auto pos = find_if(cbegin(grids), cend(grids), HasGridWon); pos != cend(grids))
-        {
-            results = {pos - cbegin(grids), elem};
-            break;
-        }
+        shuffle(begin(pool), end(pool), rng);
+        boards.cells.insert(cend(boards.cells), cbegin(pool), cbegin(pool) + N * N);
     }
-    return results;
+    auto draws = pool;
+    shuffle(begin(draws), end(draws), rng);
+
+    const auto kStart   = chrono::steady_clock::now();
+    auto engine         = BingoEngine{boards};
+    const auto kIndexed = chrono::steady_clock::now();
+    auto outcome        = engine.Play(draws);
+    const auto kEnd     = chrono::steady_clock::now();
+    const auto ms = [](auto d){ return chrono::duration<double, milli>(d).count(); };
+    cout << "N = " << N << ", boards = " << board_count
+         << ", index: " << ms(kIndexed - kStart) << " ms"
+         << ", play: "  << ms(kEnd - kIndexed) << " ms"
+         << ", first winner: " << outcome.first_winner.idx
+         << ", last winner: "  << outcome.last_winner.idx << endl;
 }
 
-int LastBoardtoWin(vector<Grid> &grids, const vector<int> &list)
+int main(int argc, const char *args[])
 {
-    auto results = -1;
-    auto is_last_grid_remaining = false;
-    for (const auto &elem : list)
+    if (argc < 2)
     {
-        is_last_grid_remaining = (grids.size() == 1);
-        for_each(begin(grids), end(grids), [&elem] (Grid &g) { MarkGrid(g, elem); });
-        if (is_last_grid_remaining == false)
-        {
-            auto pos = remove_if(begin(grids), end(grids), HasGridWon);
-            grids.erase(pos, grids.cend());
-        }
-        else
+        cout << "usage: " << args[0] << " <input file> [N] | --bench" << endl;
+        return 1;
+    }
+    if (args[1] == string_view{"--bench"})
+    {
+        RunBenchmark(5,  100'000);
+        RunBenchmark(10, 25'000);
+        RunBenchmark(32, 2'500);
+        return 0;
+    }
+    auto N = size_t{5};
+    if (argc > 2)
+    {
+        const auto kArg      = string_view{args[2]};
+        const auto [ptr, ec] = from_chars(kArg.data(), kArg.data() + kArg.size(), N);
+        if (ec != errc{} || ptr != kArg.data() + kArg.size() || N == 0)
         {
-            if (HasGridWon(grids[0]))
-            {
-                results = elem;
-                break;
-            }
+            cout << "invalid board dimension: " << kArg << endl;
+            return 1;
         }
     }
-    return results;
-}
 
-int main()
-{
-    auto fin = ifstream{"input.txt"};
+    auto fin = ifstream{args[1]};
     auto str = string{""};
     getline(fin, str, '\n');
     cout << "Parsing comma string to vector \n";
     vector<int> vec{ParseCSV(str)};
     str.clear();
     cout << "reading grids...\n";
-    auto grids = vector<Grid>{};
-    while (fin)
-    {
-        Grid g;
-        Read_N_SizeGrid(fin, g, 5);
-        grids.emplace_back(std::move(g));
-    }
-    grids.pop_back();
-    cout << "Total grids read: " << grids.size() << "\n";
-    // for_each(grids.cbegin(), grids.cend(), print);
-    // BingoResult r{PlayBingo(grids, vec)};
-    auto last_number_taken = LastBoardtoWin(grids, vec);
-    auto &winning_grid = grids[0];
-    print(winning_grid);
-    auto sum_of_unamrked = accumulate(winning_grid.cbegin(), winning_grid.cend(), 0, 
-        [](long init, const vector<int> &v)
-        {
-            return init + accumulate(v.cbegin(), v.cend(), 0, [](long init, int i){
-                if (i == -1) { return init; }
-                return init + i;
-            });
-        }
-    );
-    cout << "last number: " << last_number_taken << endl;
-    cout << sum_of_unamrked * last_number_taken;
+    const auto kBoards = ReadBoards(fin, N);
+    cout << "Total grids read: " << kBoards.Count() << "\n";
+    auto [first_winner, last_winner] = BingoEngine{kBoards}.Play(vec);
+    cout << "last number: " << last_winner.last_num_called << endl;
+    cout << "Part 1 : " << first_winner.unmarked_sum * first_winner.last_num_called << endl;
+    cout << "Part 2 : " << last_winner.unmarked_sum * last_winner.last_num_called << endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -4,166 +4,648 @@
  * @brief 
  * This code is the solution of @link https://adventofcode.com/2021/day/4 @endlink
  * The following is compiled on g++ version 9.4.0. 
- * Compilation command : g++ -std=c++17 venture.cpp
+ * Compilation command : g++ -std=c++17 -O2 -pthread venture.cpp
  * The program takes input the name of file as command line argument.
  * For example if a.out is the binary obtained by compiling this program,
  * then it should be run as:
- *                  a.out test.txt
  *                  a.out input.txt
+ *                  a.out --dense input.txt
+ * Lines that are not horizontal, vertical or at 45 degrees are ignored.
+ * By default overlaps are counted with a sparse sweep whose memory depends
+ * only on the number of lines. Passing --dense rasterises the lines onto a
+ * (max + 1) x (max + 1) plane instead, using the tiled multithreaded
+ * rasteriser, and --bench times that rasteriser on random input.
  * @date 2022-01-11
  * @copyright Copyright (c) 2022
  */ 
 #include <fstream>
 #include <iostream>
 #include <iterator>
-#include <charconv>
 #include <algorithm>
 #include <vector>
+#include <array>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <numeric>
+#include <limits>
+#include <tuple>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <queue>
 
 using namespace std;
 
-class IntegeresExtractor
-{
-    public:
-    IntegeresExtractor(const string &str): buffer{str}
-    { }
-
-    bool ExtractIntger(int &i)
-    {
-        if (idx < buffer.size())
-        {
-            auto first_digit = find_if(cbegin(buffer) + idx, cend(buffer), ::isdigit);
-            auto last_digit = find_if_not(first_digit, cend(buffer), ::isdigit);
-            auto start_idx = first_digit - cbegin(buffer);
-            auto end_idx = last_digit - cbegin(buffer);
-            idx = end_idx;
-            from_chars(&buffer[start_idx], &buffer[end_idx], i);
-            return true;
-        }
-        return false;
-    }
-    size_t idx{0};
-    string buffer;
-};
-
 struct Point
 {
     int x;
     int y;
 };
 
+struct Point2L
+{
+    long long x;
+    long long y;
+};
+
+enum Orientation : uint8_t { kHorizontal = 0, kVertical, kDiagonal, kAntiDiagonal, kOther };
+
 struct Line
 {
     Point pt1;
     Point pt2;
-    bool IsHorizontal() const
+
+    /**
+     * @brief 
+     * Classifies the line by the direction from pt1 to pt2. A single point is
+     * reported as horizontal. kDiagonal is slope +1 (x - y constant) and
+     * kAntiDiagonal is slope -1 (x + y constant).
+     */
+    Orientation Classify() const
     {
-        return pt1.y == pt2.y;
+        const auto dx = pt2.x - pt1.x;
+        const auto dy = pt2.y - pt1.y;
+        if (dy == 0)         { return kHorizontal; }
+        if (dx == 0)         { return kVertical; }
+        if (dx == dy)        { return kDiagonal; }
+        if (dx == -dy)       { return kAntiDiagonal; }
+        return kOther;
     }
+};
 
-    bool IsVertical() const
+/**
+ * @brief 
+ * Lines stored as a struct of arrays, classified once when they are added.
+ */
+struct LineBuffer
+{
+    vector<int> x1, y1, x2, y2;
+    vector<Orientation> orientation;
+
+    size_t size() const { return orientation.size(); }
+    Line operator[](size_t idx) const { return {{x1[idx], y1[idx]}, {x2[idx], y2[idx]}}; }
+
+    void reserve(size_t n)
     {
-        return pt1.x == pt2.x;
+        x1.reserve(n); y1.reserve(n); x2.reserve(n); y2.reserve(n); orientation.reserve(n);
     }
 
-    bool IsDiagonal() const
+    void push_back(const Line &line)
     {
-        return (abs(pt1.x - pt2.x) / abs(pt1.y - pt2.y)) == 1;
+        x1.push_back(line.pt1.x); y1.push_back(line.pt1.y);
+        x2.push_back(line.pt2.x); y2.push_back(line.pt2.y);
+        orientation.push_back(line.Classify());
     }
 
+    int MaxCoordinate() const
+    {
+        auto result = 0;
+        for (const auto *vec : {&x1, &y1, &x2, &y2})
+        {
+            if (!vec->empty()) { result = max(result, *max_element(cbegin(*vec), cend(*vec))); }
+        }
+        return result;
+    }
+
+    template<typename Pred>
+    LineBuffer Filter(Pred pred) const
+    {
+        auto result = LineBuffer{};
+        for (auto idx = size_t{0}; idx < size(); ++idx)
+        {
+            if (pred(orientation[idx])) { result.push_back((*this)[idx]); }
+        }
+        return result;
+    }
 };
 
-string ReadAll()
+/**
+ * @brief 
+ * Streams "x1,y1 -> x2,y2" records out of @arg filename in fixed size chunks.
+ * Every run of digits is one coordinate; each group of four coordinates
+ * becomes a Line pushed straight into the returned buffer, so the file is
+ * never held in memory as a whole. Lines are pre-reserved from the file size
+ * (the shortest possible record "0,0 -> 0,0\n" is 11 bytes).
+ */
+LineBuffer ReadLines(const string &filename)
 {
-    auto fin = ifstream{"input.txt"};
-    return {istreambuf_iterator<char>{fin}, istreambuf_iterator<char>{}};
+    auto fin    = ifstream{filename, ios::binary | ios::ate};
+    auto lines  = LineBuffer{};
+    if (!fin) { return lines; }
+    lines.reserve(static_cast<size_t>(fin.tellg()) / 11 + 1);
+    fin.seekg(0);
+
+    auto chunk     = vector<char>(1 << 16);
+    auto coords    = array<int, 4>{};
+    auto coord_idx = size_t{0};
+    auto value     = 0;
+    auto in_number = false;
+    const auto kEndNumber = [&](){
+        coords[coord_idx++] = value;
+        value     = 0;
+        in_number = false;
+        if (coord_idx == coords.size())
+        {
+            lines.push_back({{coords[0], coords[1]}, {coords[2], coords[3]}});
+            coord_idx = 0;
+        }
+    };
+    while (fin.read(chunk.data(), chunk.size()) || fin.gcount() > 0)
+    {
+        const auto kCount = static_cast<size_t>(fin.gcount());
+        for (auto idx = size_t{0}; idx < kCount; ++idx)
+        {
+            const auto kCh = chunk[idx];
+            if (kCh >= '0' && kCh <= '9')
+            {
+                value     = value * 10 + (kCh - '0');
+                in_number = true;
+            }
+            else if (in_number) { kEndNumber(); }
+        }
+    }
+    if (in_number) { kEndNumber(); }
+    return lines;
 }
 
-vector<int> ReadIntegers()
+/**
+ * @brief 
+ * Parallel rasteriser for bounded coordinate ranges. Only "covered twice or
+ * more" matters, so each cell is a uint8_t saturating at 2.
+ * The plane is cut into kTileSize x kTileSize tiles (64 KiB each, so a tile
+ * stays cache resident). Lines are first binned into the tiles they pass
+ * through as clipped spans, in parallel with one bin set per thread. Then the
+ * threads pull tiles off a shared counter, rasterise every span of that tile
+ * into a private buffer and count the saturated cells. The counting loop is
+ * branch free over bytes and is auto-vectorised by the compiler at -O2/-O3.
+ */
+class TiledRasterizer
 {
-    auto i = -1;
-    auto int_extractor = IntegeresExtractor{ReadAll()};
-    auto raw = vector<int>{};
-    while (int_extractor.ExtractIntger(i)) { raw.push_back(i); }
-    return raw;
-}
+    public:
+    static constexpr int kTileSize = 256;
 
-using Grid = vector<vector<int>>;
+    TiledRasterizer(int width, int height, unsigned thread_count = thread::hardware_concurrency())
+        : kTilesX{(width + kTileSize - 1) / kTileSize}, kTilesY{(height + kTileSize - 1) / kTileSize},
+          kThreadCount{max(1u, thread_count)}
+    { }
+
+    size_t operator()(const LineBuffer &lines) const
+    {
+        //bins[thread][tile] holds the spans that thread found for that tile
+        auto bins = vector<vector<vector<Span>>>(kThreadCount, vector<vector<Span>>(static_cast<size_t>(kTilesX) * kTilesY));
+        RunOnAllThreads([&](unsigned thread_idx){
+            const auto kChunk = (lines.size() + kThreadCount - 1) / kThreadCount;
+            const auto kFirst = min(lines.size(), thread_idx * kChunk);
+            const auto kLast  = min(lines.size(), kFirst + kChunk);
+            for (auto idx = kFirst; idx < kLast; ++idx)
+            {
+                if (lines.orientation[idx] != kOther) { BinLine(lines[idx], bins[thread_idx]); }
+            }
+        });
 
-void drawLineOnGrid(Grid &grid, const Line &line)
+        auto next_tile = atomic<size_t>{0};
+        auto total     = atomic<size_t>{0};
+        RunOnAllThreads([&](unsigned /*thread_idx*/){
+            auto buffer = vector<uint8_t>(kTileSize * kTileSize);
+            auto local_total = size_t{0};
+            for (auto tile = next_tile++; tile < bins.front().size(); tile = next_tile++)
+            {
+                fill(begin(buffer), end(buffer), uint8_t{0});
+                const auto kOriginX = static_cast<int>(tile % kTilesX) * kTileSize;
+                const auto kOriginY = static_cast<int>(tile / kTilesX) * kTileSize;
+                for (const auto &thread_bins : bins)
+                {
+                    for (const auto &span : thread_bins[tile])
+                    {
+                        auto x = span.x - kOriginX;
+                        auto y = span.y - kOriginY;
+                        for (auto step = 0; step <= span.length; ++step, x += span.dx, y += span.dy)
+                        {
+                            auto &cell = buffer[y * kTileSize + x];
+                            cell += (cell < 2);
+                        }
+                    }
+                }
+                auto tile_total = 0u;
+                for (const auto &cell : buffer) { tile_total += (cell >> 1); }
+                local_total += tile_total;
+            }
+            total += local_total;
+        });
+        return total;
+    }
+
+    private:
+    /**
+     * @brief A piece of a line clipped to a single tile: start point, unit step and number of steps.
+     */
+    struct Span
+    {
+        int x;
+        int y;
+        int length;
+        int8_t dx;
+        int8_t dy;
+    };
+
+    void BinLine(const Line &line, vector<vector<Span>> &bins) const
+    {
+        const auto dx = static_cast<int8_t>((line.pt2.x > line.pt1.x) - (line.pt2.x < line.pt1.x));
+        const auto dy = static_cast<int8_t>((line.pt2.y > line.pt1.y) - (line.pt2.y < line.pt1.y));
+        const auto n  = max(abs(line.pt2.x - line.pt1.x), abs(line.pt2.y - line.pt1.y));
+        //Steps left inside the current tile along one axis, moving in direction d.
+        const auto kStepsInTile = [](int coord, int d){
+            if (d > 0) { return kTileSize - 1 - coord % kTileSize; }
+            if (d < 0) { return coord % kTileSize; }
+            return numeric_limits<int>::max();
+        };
+        for (auto s = 0; s <= n;)
+        {
+            const auto x = line.pt1.x + s * dx;
+            const auto y = line.pt1.y + s * dy;
+            const auto kSteps = min({kStepsInTile(x, dx), kStepsInTile(y, dy), n - s});
+            bins[static_cast<size_t>(y / kTileSize) * kTilesX + x / kTileSize].push_back({x, y, kSteps, dx, dy});
+            s += kSteps + 1;
+        }
+    }
+
+    template<typename Func>
+    void RunOnAllThreads(Func func) const
+    {
+        auto workers = vector<thread>{};
+        for (auto thread_idx = 1u; thread_idx < kThreadCount; ++thread_idx) { workers.emplace_back(func, thread_idx); }
+        func(0u);
+        for (auto &worker : workers) { worker.join(); }
+    }
+
+    const int kTilesX;
+    const int kTilesY;
+    const unsigned kThreadCount;
+};
+
+/**
+ * @brief 
+ * Times TiledRasterizer on {line_count} random horizontal, vertical and
+ * diagonal lines inside a {size} x {size} plane.
+ */
+void RunRasterizerBenchmark(size_t line_count, int size)
 {
-    if (line.IsVertical())
+    auto rng   = mt19937{42};
+    auto coord = uniform_int_distribution<int>{0, size - 1};
+    auto kind  = uniform_int_distribution<int>{0, 3};
+    auto lines = LineBuffer{};
+    lines.reserve(line_count);
+    while (lines.size() < line_count)
     {
-        auto row = line.pt1.x;
-        auto [s, e] = std::minmax(line.pt1.y, line.pt2.y);
-        for (auto col = s; col <= e; ++col)
+        const auto kStart = Point{coord(rng), coord(rng)};
+        auto end_pt = Point{coord(rng), coord(rng)};
+        switch (kind(rng))
         {
-            ++grid[row][col];
+            case 0: end_pt.y = kStart.y; break;
+            case 1: end_pt.x = kStart.x; break;
+            default:
+            {
+                //clip to a 45 degree line that stays inside the plane
+                const auto kLen = min(abs(end_pt.x - kStart.x), abs(end_pt.y - kStart.y));
+                end_pt.x = kStart.x + (end_pt.x >= kStart.x ? kLen : -kLen);
+                end_pt.y = kStart.y + (end_pt.y >= kStart.y ? kLen : -kLen);
+            }
         }
+        lines.push_back({kStart, end_pt});
     }
-    else if (line.IsHorizontal())
+    const auto kStart = chrono::steady_clock::now();
+    const auto kCount = TiledRasterizer{size, size}(lines);
+    const auto kEnd   = chrono::steady_clock::now();
+    cout << line_count << " lines on " << size << " x " << size << ": " << kCount << " overlaps in "
+         << chrono::duration<double, milli>(kEnd - kStart).count() << " ms ("
+         << max(1u, thread::hardware_concurrency()) << " threads)" << endl;
+}
+
+/**
+ * @brief 
+ * A horizontal, vertical or 45 degree line expressed as origin + s * direction
+ * for s in [0, length]. The carrier key identifies the infinite line the
+ * segment lies on (y, x, x - y and x + y respectively) and [lo, hi] is the
+ * covered range of the parameter along that carrier (x, y, x and x).
+ */
+struct Segment
+{
+    Orientation orientation;
+    long long key;
+    long long lo;
+    long long hi;
+
+    Point2L Origin() const
     {
-        auto col = line.pt1.y;
-        auto [s, e] = std::minmax(line.pt1.x, line.pt2.x);
-        for (auto row = s; row <= e; ++row)
+        switch (orientation)
         {
-            ++grid[row][col];
+            case kHorizontal:   return {lo, key};
+            case kVertical:     return {key, lo};
+            case kDiagonal:     return {lo, lo - key};
+            case kAntiDiagonal: return {lo, key - lo};
+            case kOther:        break;
         }
+        return {};
     }
-    else if (line.IsDiagonal())
+    Point2L Direction() const
     {
-        auto inc_x = 0;
-        auto row = line.pt1.x;
-        if (line.pt1.x > line.pt2.x) { inc_x = -1; }
-        else { inc_x = +1; }
+        switch (orientation)
+        {
+            case kHorizontal:   return {1, 0};
+            case kVertical:     return {0, 1};
+            case kDiagonal:     return {1, 1};
+            case kAntiDiagonal: return {1, -1};
+            case kOther:        break;
+        }
+        return {};
+    }
+    long long MinX() const { return orientation == kVertical ? key : lo; }
+    long long MaxX() const { return orientation == kVertical ? key : hi; }
 
-        auto inc_y = 0;
-        auto col = line.pt1.y;
-        if (line.pt1.y < line.pt2.y) { inc_y = +1; }
-        else { inc_y = -1; }
-        
-        for (; row != (line.pt2.x + inc_x) && col != (line.pt2.y + inc_y) ;row += inc_x, col += inc_y)
+    static Segment FromLine(const Line &line, Orientation orientation)
+    {
+        const auto x1 = static_cast<long long>(line.pt1.x), y1 = static_cast<long long>(line.pt1.y);
+        const auto x2 = static_cast<long long>(line.pt2.x), y2 = static_cast<long long>(line.pt2.y);
+        switch (orientation)
         {
-            ++grid[row][col];
+            case kHorizontal:   return {orientation, y1,      min(x1, x2), max(x1, x2)};
+            case kVertical:     return {orientation, x1,      min(y1, y2), max(y1, y2)};
+            case kDiagonal:     return {orientation, x1 - y1, min(x1, x2), max(x1, x2)};
+            default:            return {orientation, x1 + y1, min(x1, x2), max(x1, x2)};
         }
     }
+};
+
+/**
+ * @brief 
+ * Returns the lattice point where two segments of different orientation
+ * cross, if any. Solves origin1 + s * d1 = origin2 + u * d2 with Cramer's rule.
+ */
+optional<Point2L> Intersect(const Segment &a, const Segment &b)
+{
+    const auto kCross = [](Point2L p, Point2L q){ return p.x * q.y - p.y * q.x; };
+    const auto o1 = a.Origin(), d1 = a.Direction();
+    const auto o2 = b.Origin(), d2 = b.Direction();
+    const auto kDenom = kCross(d1, d2);
+    const auto kDiff  = Point2L{o2.x - o1.x, o2.y - o1.y};
+    const auto kSNum  = kCross(kDiff, d2);
+    const auto kUNum  = kCross(kDiff, d1);
+    if (kSNum % kDenom != 0 || kUNum % kDenom != 0) { return nullopt; }//crossing is not on a lattice point
+    const auto s = kSNum / kDenom;
+    const auto u = kUNum / kDenom;
+    if (s < 0 || s > a.hi - a.lo || u < 0 || u > b.hi - b.lo) { return nullopt; }
+    return Point2L{o1.x + s * d1.x, o1.y + s * d1.y};
 }
 
-int main()
+/**
+ * @brief 
+ * Counts lattice points covered by at least two lines without materialising
+ * the plane, so memory scales with the number of lines instead of the
+ * coordinate range.
+ * 1. Lines are grouped by carrier (orientation + key). Within one carrier the
+ *    intervals are sorted and swept once, producing the merged union
+ *    intervals and the merged intervals covered twice or more.
+ * 2. Union intervals of different orientations can only meet in single
+ *    points. Those are found with an event sweep over x: intervals open at
+ *    MinX() and close after MaxX(), and the open ones are kept per
+ *    orientation in maps ordered by carrier key. An opening interval only
+ *    visits the open keys its own span can reach, so pairs that cannot cross
+ *    are never tested.
+ * 3. The answer is the number of points in same-carrier overlaps plus the
+ *    distinct crossing points, correcting for crossing points that were
+ *    already counted in the overlaps of one or more carriers. Up to four
+ *    union intervals (one per orientation) pass through a point, so a
+ *    crossing is counted only by the pair of the two lowest orientations
+ *    present there, and then discarded.
+ */
+class SparseOverlapCounter
 {
-    
-    // cout << data << endl;
-    auto raw = ReadIntegers();
-    auto points = vector<Point>{};
-    points.reserve(raw.size() / 2);   
-    for (auto idx = size_t{0}; idx < raw.size(); idx+=2)
+    public:
+    size_t operator()(const LineBuffer &lines)
+    {
+        BuildCarriers(lines);
+        auto total = size_t{0};
+        for (const auto &[carrier_ignore, intervals] : overlaps)
+        {
+            for (const auto &[lo, hi] : intervals) { total += static_cast<size_t>(hi - lo + 1); }
+        }
+        //A crossing point already counted in m overlaps (one per orientation) must end up counted exactly once.
+        ForEachCrossing([&](const Point2L &pt, size_t a, size_t b){ total = total + 1 - OverlapCount(pt, a, b); });
+        return total;
+    }
+
+    private:
+    using Interval = pair<long long, long long>;
+    using Carrier  = pair<int, long long>;//orientation, key
+    using CarrierIntervals = map<Carrier, vector<Interval>>;
+
+    void BuildCarriers(const LineBuffer &lines)
+    {
+        auto by_carrier = map<Carrier, vector<Interval>>{};
+        for (auto idx = size_t{0}; idx < lines.size(); ++idx)
+        {
+            if (lines.orientation[idx] == kOther) { continue; }
+            const auto kSeg = Segment::FromLine(lines[idx], lines.orientation[idx]);
+            by_carrier[{kSeg.orientation, kSeg.key}].push_back({kSeg.lo, kSeg.hi});
+        }
+        for (auto &[carrier, intervals] : by_carrier)
+        {
+            sort(begin(intervals), end(intervals));
+            auto &overlap = overlaps[carrier];
+            auto &merged  = unions[carrier];
+            auto reach    = intervals.front().second;
+            auto union_lo = intervals.front().first;
+            for (auto itr = cbegin(intervals) + 1; itr != cend(intervals); ++itr)
+            {
+                const auto [lo, hi] = *itr;
+                if (lo <= reach)
+                {
+                    const auto kOverlapHi = min(hi, reach);
+                    if (!overlap.empty() && lo <= overlap.back().second + 1) { overlap.back().second = max(overlap.back().second, kOverlapHi); }
+                    else                                                     { overlap.push_back({lo, kOverlapHi}); }
+                }
+                else
+                {
+                    merged.push_back({union_lo, reach});
+                    union_lo = lo;
+                }
+                reach = max(reach, hi);
+            }
+            merged.push_back({union_lo, reach});
+            for (const auto &[lo, hi] : merged) { union_segments.push_back({static_cast<Orientation>(carrier.first), carrier.second, lo, hi}); }
+            union_orientations |= 1u << carrier.first;
+            if (overlap.empty()) { overlaps.erase(carrier); }
+            else                 { overlap_orientations |= 1u << carrier.first; }
+        }
+        segment_overlaps.reserve(union_segments.size());
+        for (const auto &segment : union_segments)
+        {
+            const auto pos = overlaps.find({segment.orientation, segment.key});
+            segment_overlaps.push_back(pos == cend(overlaps) ? nullptr : &pos->second);
+        }
+    }
+
+    /**
+     * @brief 
+     * Calls @arg on_point once for every distinct lattice point where union
+     * intervals of two or more orientations meet, with the indices of the two
+     * lowest orientation intervals through it. Each crossing pair is found
+     * by whichever of the two opens later (vertical intervals, which occupy a
+     * single column, open after the others of their column), while the other
+     * one is still open.
+     */
+    template<typename Func>
+    void ForEachCrossing(Func on_point) const
     {
-        points.push_back({raw[idx], raw[idx + 1]});
+        auto order = vector<size_t>(union_segments.size());
+        iota(begin(order), end(order), size_t{0});
+        sort(begin(order), end(order), [this](size_t i, size_t j){
+            const auto &a = union_segments[i], &b = union_segments[j];
+            return pair{a.MinX(), a.orientation == kVertical} < pair{b.MinX(), b.orientation == kVertical};
+        });
+        using Closing = pair<long long, size_t>;//MaxX, segment
+        auto closing = priority_queue<Closing, vector<Closing>, greater<Closing>>{};
+        array<map<long long, size_t>, 4> open;//per orientation: carrier key -> segment
+        for (const auto &idx : order)
+        {
+            const auto &kSeg = union_segments[idx];
+            for (; !closing.empty() && closing.top().first < kSeg.MinX(); closing.pop())
+            {
+                const auto &kDone = union_segments[closing.top().second];
+                open[kDone.orientation].erase(kDone.key);
+            }
+            const auto kFirst = kSeg.Origin();
+            const auto kLast  = Point2L{kFirst.x + (kSeg.hi - kSeg.lo) * kSeg.Direction().x, kFirst.y + (kSeg.hi - kSeg.lo) * kSeg.Direction().y};
+            for (auto orientation = 0; orientation < 4; ++orientation)
+            {
+                if (orientation == kSeg.orientation) { continue; }
+                //The carrier key of the other orientation changes monotonically along this segment.
+                const auto kKeyA = CarrierAt(static_cast<Orientation>(orientation), kFirst).first.second;
+                const auto kKeyB = CarrierAt(static_cast<Orientation>(orientation), kLast).first.second;
+                const auto &kOpen = open[orientation];
+                for (auto itr = kOpen.lower_bound(min(kKeyA, kKeyB)); itr != cend(kOpen) && itr->first <= max(kKeyA, kKeyB); ++itr)
+                {
+                    const auto &kOther = union_segments[itr->second];
+                    if (const auto kPt = Intersect(kSeg, kOther); kPt && IsLowestPair(*kPt, kSeg.orientation, kOther.orientation)) { on_point(*kPt, idx, itr->second); }
+                }
+            }
+            if (kSeg.orientation == kVertical) { continue; }//no later interval can reach its column
+            open[kSeg.orientation][kSeg.key] = idx;
+            closing.push({kSeg.MaxX(), idx});
+        }
     }
-    auto Lines = vector<Line>{};
-    Lines.reserve(points.size() / 2);
-    for (auto idx = size_t{0}; idx < points.size(); idx+=2)
+
+    /**
+     * @brief True if @arg a and @arg b are the two lowest orientations among the union intervals through @arg pt.
+     */
+    bool IsLowestPair(const Point2L &pt, Orientation a, Orientation b) const
     {
-        Lines.push_back({points[idx], points[idx + 1]});
+        for (auto orientation = 0; orientation < max(a, b); ++orientation)
+        {
+            if (orientation == a || orientation == b || !(union_orientations >> orientation & 1)) { continue; }
+            if (Covers(unions, CarrierAt(static_cast<Orientation>(orientation), pt))) { return false; }
+        }
+        return true;
     }
-    auto iter = remove_if(begin(Lines), end(Lines), [](const auto &line)
+
+    /**
+     * @brief 
+     * Number of carriers through @arg pt on which @arg pt lies inside an
+     * overlap interval, given the union intervals @arg a and @arg b that
+     * cross there. Their own overlaps are cached per segment; the other
+     * orientations are only looked up when they have overlaps at all.
+     */
+    size_t OverlapCount(const Point2L &pt, size_t a, size_t b) const
     {
-        return !(line.IsVertical() || line.IsHorizontal() || line.IsDiagonal());
-    });
-    Lines.erase(iter, cend(Lines));
-    auto max = *max_element(cbegin(raw), cend(raw));
+        auto count = size_t{0};
+        for (const auto &idx : {a, b})
+        {
+            if (const auto *kIntervals = segment_overlaps[idx]; kIntervals)
+            {
+                count += Contains(*kIntervals, CarrierAt(union_segments[idx].orientation, pt).second);
+            }
+        }
+        for (auto orientation = 0; orientation < 4; ++orientation)
+        {
+            if (orientation == union_segments[a].orientation || orientation == union_segments[b].orientation) { continue; }
+            if (overlap_orientations >> orientation & 1) { count += Covers(overlaps, CarrierAt(static_cast<Orientation>(orientation), pt)); }
+        }
+        return count;
+    }
 
-    auto grid = vector<vector<int>>(max + 1, vector<int>(max + 1, 0));
-    for (const auto &line : Lines)
+    /**
+     * @brief Carrier of @arg orientation through @arg pt, and the position of @arg pt along it.
+     */
+    static pair<Carrier, long long> CarrierAt(Orientation orientation, const Point2L &pt)
     {
-        drawLineOnGrid(grid, line);
+        switch (orientation)
+        {
+            case kHorizontal:   return {{kHorizontal,   pt.y},        pt.x};
+            case kVertical:     return {{kVertical,     pt.x},        pt.y};
+            case kDiagonal:     return {{kDiagonal,     pt.x - pt.y}, pt.x};
+            default:            return {{kAntiDiagonal, pt.x + pt.y}, pt.x};
+        }
     }
 
-    auto total_count = 0;
-    for (const auto &vec : grid)
+    /**
+     * @brief True if @arg t lies inside one of the sorted, disjoint @arg intervals.
+     */
+    static bool Contains(const vector<Interval> &intervals, long long t)
     {
-        total_count += count_if(cbegin(vec), cend(vec), [](const auto &elem){ return elem >= 2; });
+        auto itr = upper_bound(cbegin(intervals), cend(intervals), Interval{t, numeric_limits<long long>::max()});
+        return itr != cbegin(intervals) && prev(itr)->second >= t;
     }
-    cout << "Part 2 : " << total_count;
+
+    /**
+     * @brief True if position t of the carrier lies inside one of its @arg intervals.
+     */
+    static bool Covers(const CarrierIntervals &intervals, const pair<Carrier, long long> &carrier_and_t)
+    {
+        const auto &[carrier, t] = carrier_and_t;
+        const auto pos = intervals.find(carrier);
+        return pos != cend(intervals) && Contains(pos->second, t);
+    }
+
+    CarrierIntervals overlaps;//disjoint, sorted intervals covered by >= 2 lines per carrier
+    CarrierIntervals unions;  //disjoint, sorted intervals covered by >= 1 line per carrier
+    vector<Segment> union_segments;//the pieces of {unions}, one per interval
+    vector<const vector<Interval> *> segment_overlaps;//union_segments[i] -> overlaps of its carrier, nullptr if none
+    unsigned union_orientations{0};  //bit o set if some carrier of orientation o has lines
+    unsigned overlap_orientations{0};//bit o set if some carrier of orientation o has overlaps
+};
+
+int main(int argc, const char *args[])
+{
+    if (argc < 2)
+    {
+        cout << "usage: " << args[0] << " [--dense] <input file> | --bench" << endl;
+        return 1;
+    }
+    const auto kMode = string_view{args[1]};
+    if (kMode == "--bench")
+    {
+        RunRasterizerBenchmark(1'000'000, 10'000);
+        return 0;
+    }
+    const auto kUseDense = (kMode == "--dense");
+    if (kUseDense && argc < 3)
+    {
+        cout << "usage: " << args[0] << " --dense <input file>" << endl;
+        return 1;
+    }
+    const auto kLines = ReadLines(args[kUseDense ? 2 : 1]);
+    const auto kStraightLines = kLines.Filter([](Orientation o){ return o == kHorizontal || o == kVertical; });
+    if (kUseDense)
+    {
+        const auto kSize = kLines.MaxCoordinate() + 1;
+        cout << "Part 1 : " << TiledRasterizer{kSize, kSize}(kStraightLines) << endl;
+        cout << "Part 2 : " << TiledRasterizer{kSize, kSize}(kLines) << endl;
+        return 0;
+    }
+    cout << "Part 1 : " << SparseOverlapCounter{}(kStraightLines) << endl;
+    cout << "Part 2 : " << SparseOverlapCounter{}(kLines) << endl;
     return 0;
-}
\ No newline at end of file
+}
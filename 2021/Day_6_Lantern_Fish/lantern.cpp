@@ -5,6 +5,12 @@
  * The following is compiled on g++ version 9.4.0.
  * Compilation command : g++ -std=c++17 ./lantern.cpp
  *  This code is the solution of @link https://adventofcode.com/2021/day/1 @endlink
+ *  Usage: a.out input.txt [days]
+ *         a.out input.txt --days 18,80,256,1000
+ *  Without {days} both parts (80 and 256 days) are printed. A single day
+ *  count uses matrix exponentiation, a list of days is answered by one
+ *  forward pass of the histogram simulation, up to 100000 days; larger days
+ *  in the list fall back to matrix exponentiation.
  *  
  * @copyright Copyright (c) 2024
  * 
@@ -19,71 +25,275 @@
 #include <list>
 #include <string_view>
 #include <unordered_map>
-#include <utility>
-#include <map>
+#include <array>
+#include <string>
+#include <cstdint>
+#include <system_error>
+#include <optional>
+#include <cctype>
 
 using namespace std;
-vector<int> readInput(const string  &filename)
+/**
+ * @brief Reads the comma separated timers; nullopt if any entry is not a timer between 0 and 8.
+ */
+optional<vector<int>> readInput(const string  &filename)
 {
     auto fin      = ifstream{filename};
     auto vec      = vector<int>{};
     auto temp_str = string{};
-    auto temp_i   = 0;
     while (getline(fin, temp_str, ','))
     {
-        from_chars(data(temp_str), data(temp_str) + size(temp_str), temp_i);
+        auto str = string_view{temp_str};
+        while (!str.empty() && isspace(static_cast<unsigned char>(str.back()))) { str.remove_suffix(1); }
+        auto temp_i          = 0;
+        const auto [ptr, ec] = from_chars(str.data(), str.data() + str.size(), temp_i);
+        if (ec != errc{} || ptr != str.data() + str.size() || str.empty() || temp_i < 0 || temp_i > 8) { return nullopt; }
         vec.push_back(temp_i);
     }
     return vec;
 }
 
-struct LanterFishCalculator
+/**
+ * @brief 
+ * Unsigned 128-bit value that remembers whether any operation overflowed.
+ */
+struct Exact128
 {
-    size_t operator()(int initial_timer, int days)
+    unsigned __int128 value{0};
+    bool overflow{false};
+
+    friend Exact128 operator+(const Exact128 &a, const Exact128 &b)
     {
-        return LanterFishUtility_REC(initial_timer, days);
+        auto r = Exact128{0, a.overflow || b.overflow};
+        r.overflow |= __builtin_add_overflow(a.value, b.value, &r.value);
+        return r;
     }
-    private:
-    size_t LanterFishUtility_REC(int timer, int days)
+    friend Exact128 operator*(const Exact128 &a, const Exact128 &b)
+    {
+        auto r = Exact128{0, a.overflow || b.overflow};
+        r.overflow |= __builtin_mul_overflow(a.value, b.value, &r.value);
+        return r;
+    }
+    string ToString() const
+    {
+        if (value == 0) { return "0"; }
+        auto str = string{};
+        for (auto v = value; v > 0; v /= 10) { str.push_back(static_cast<char>('0' + static_cast<int>(v % 10))); }
+        return {crbegin(str), crend(str)};
+    }
+};
+
+/**
+ * @brief 
+ * Value modulo kModulus, used once the exact population no longer fits in 128 bits.
+ */
+struct ModInt
+{
+    static constexpr uint64_t kModulus = 1'000'000'007;
+    uint64_t value{0};
+
+    friend ModInt operator+(const ModInt &a, const ModInt &b) { return {(a.value + b.value) % kModulus}; }
+    friend ModInt operator*(const ModInt &a, const ModInt &b)
+    {
+        return {static_cast<uint64_t>(static_cast<unsigned __int128>(a.value) * b.value % kModulus)};
+    }
+    string ToString() const { return to_string(value); }
+};
+
+template<typename T>
+using Matrix9 = array<array<T, 9>, 9>;
+
+template<typename T>
+Matrix9<T> Multiply(const Matrix9<T> &a, const Matrix9<T> &b)
+{
+    auto c = Matrix9<T>{};
+    for (auto i = 0; i < 9; ++i)
     {
-        //if answer is already computed, then return saved answer
-        if (dp_map.find({timer, days}) != dp_map.cend()) { return dp_map[{timer, days}]; }
-        auto total_fishes = size_t{0};
-        if (days == 0)     { total_fishes = 0; }
-        if (days <= timer) { total_fishes = 1; }//If no of days are less than fish timer, then no new fishes will be generated
-        else
+        for (auto k = 0; k < 9; ++k)
         {
-            total_fishes = 1;
-            for (auto new_fish_day = timer + 1; new_fish_day <= days ;new_fish_day += (6 + 1))
-            {
-                total_fishes += LanterFishUtility_REC(8, days - new_fish_day);
-            }
+            if (a[i][k].value == 0) { continue; }
+            for (auto j = 0; j < 9; ++j) { c[i][j] = c[i][j] + a[i][k] * b[k][j]; }
         }
-        dp_map[{timer, days}] = total_fishes;
-        return total_fishes;
     }
-    static map<pair<int, int>, size_t> dp_map;
-};
-map<pair<int, int>, size_t> LanterFishCalculator::dp_map;
+    return c;
+}
 
-auto CalculateFishCountAfter_N_Days(const vector<int> &initial_timers, const int &N)
+/**
+ * @brief 
+ * Population after {days} days using a 9 state transition matrix M where
+ * state i is the number of fishes whose timer is i. In one day:
+ *     new[i] = old[i + 1]   for i = 0 ... 7
+ *     new[6] += old[0]      (parents reset to 6)
+ *     new[8]  = old[0]      (newborns)
+ * The histogram of initial timers is multiplied by M^days, computed by
+ * repeated squaring, so the cost is O(9^3 * log(days)).
+ */
+template<typename T>
+T FishCountByMatrixPower(const vector<int> &initial_timers, unsigned long long days)
 {
-    auto lanter_fish_calculator = LanterFishCalculator{};
-    auto total_fishes           = size_t{ 0 };
-    //Calculate how fishes will be available after {N} days.
-    //NOTE: LanterFishCalculator uses memoization technique to store previous results
-    //So many of the times same computations will not be performed again.
-    for (const auto &timer : initial_timers) { total_fishes += lanter_fish_calculator(timer, N); }
-    return total_fishes;
+    auto transition = Matrix9<T>{};
+    for (auto i = 0; i < 8; ++i) { transition[i][i + 1] = T{1}; }
+    transition[6][0] = T{1};
+    transition[8][0] = T{1};
+
+    auto power = Matrix9<T>{};
+    for (auto i = 0; i < 9; ++i) { power[i][i] = T{1}; }
+    for (; days > 0; days >>= 1)
+    {
+        if (days & 1) { power = Multiply(power, transition); }
+        if (days > 1) { transition = Multiply(transition, transition); }
+    }
+
+    auto histogram = array<T, 9>{};
+    for (const auto &timer : initial_timers) { histogram[timer] = histogram[timer] + T{1}; }
+    auto total = T{};
+    for (auto i = 0; i < 9; ++i)
+    {
+        for (auto j = 0; j < 9; ++j) { total = total + power[i][j] * histogram[j]; }
+    }
+    return total;
+}
+
+/**
+ * @brief 
+ * Simulates the population day by day on 9 counters and records the total at
+ * every day listed in @arg query_days (which must be sorted). The counters
+ * are never shifted: timer t lives in buckets[(head + t) % 9] and a day only
+ * advances {head}. The bucket that held timer 0 then naturally holds the
+ * newborns at timer 8, and its count is added to timer 6 for the parents.
+ */
+template<typename T>
+vector<T> FishCountsByHistogram(const vector<int> &initial_timers, const vector<unsigned long long> &query_days)
+{
+    auto buckets = array<T, 9>{};
+    for (const auto &timer : initial_timers) { buckets[timer] = buckets[timer] + T{1}; }
+    auto results = vector<T>{};
+    results.reserve(query_days.size());
+    auto head = size_t{0};
+    auto day  = 0ULL;
+    for (const auto &query_day : query_days)
+    {
+        for (; day < query_day; ++day)
+        {
+            head = (head + 1) % 9;
+            auto &parents = buckets[(head + 6) % 9];
+            parents = parents + buckets[(head + 8) % 9];
+        }
+        auto total = T{};
+        for (const auto &count : buckets) { total = total + count; }
+        results.push_back(total);
+    }
+    return results;
+}
+
+/**
+ * @brief 
+ * Prints the exact population when it fits in 128 bits, otherwise the population modulo ModInt::kModulus.
+ */
+void PrintFishCount(const vector<int> &initial_timers, unsigned long long days)
+{
+    cout << "After " << days << " days: ";
+    if (const auto kExact = FishCountByMatrixPower<Exact128>(initial_timers, days); kExact.overflow == false)
+    {
+        cout << kExact.ToString() << endl;
+    }
+    else
+    {
+        cout << FishCountByMatrixPower<ModInt>(initial_timers, days).ToString() << " (mod " << ModInt::kModulus << ")" << endl;
+    }
+}
+
+/**
+ * @brief 
+ * Prints the population at every day of @arg query_days. Days up to
+ * kMaxForwardPassDays are answered by one forward pass, and days whose exact
+ * population does not fit in 128 bits are printed modulo ModInt::kModulus,
+ * from a second pass. Each later day is answered by PrintFishCount(), so the
+ * cost stays logarithmic in the largest query.
+ */
+void PrintFishCounts(const vector<int> &initial_timers, vector<unsigned long long> query_days)
+{
+    constexpr auto kMaxForwardPassDays = 100'000ULL;
+    sort(begin(query_days), end(query_days));
+    query_days.erase(unique(begin(query_days), end(query_days)), cend(query_days));
+    const auto kFirstLarge = upper_bound(cbegin(query_days), cend(query_days), kMaxForwardPassDays);
+    const auto kLargeDays  = vector<unsigned long long>{kFirstLarge, cend(query_days)};
+    query_days.erase(kFirstLarge, cend(query_days));
+    const auto kExact = FishCountsByHistogram<Exact128>(initial_timers, query_days);
+    auto modular = vector<ModInt>{};
+    if (any_of(cbegin(kExact), cend(kExact), [](const Exact128 &e){ return e.overflow; }))
+    {
+        modular = FishCountsByHistogram<ModInt>(initial_timers, query_days);
+    }
+    for (auto idx = size_t{0}; idx < query_days.size(); ++idx)
+    {
+        cout << "After " << query_days[idx] << " days: ";
+        if (kExact[idx].overflow == false) { cout << kExact[idx].ToString() << endl; }
+        else { cout << modular[idx].ToString() << " (mod " << ModInt::kModulus << ")" << endl; }
+    }
+    for (const auto &days : kLargeDays) { PrintFishCount(initial_timers, days); }
+}
+
+/**
+ * @brief Parses a whole string as a day count; nullopt if it is not a plain non-negative number.
+ */
+optional<unsigned long long> ParseDay(string_view str)
+{
+    auto day = 0ULL;
+    const auto [ptr, ec] = from_chars(str.data(), str.data() + str.size(), day);
+    if (ec != errc{} || ptr != str.data() + str.size() || str.empty()) { return nullopt; }
+    return day;
+}
+
+/**
+ * @brief Parses a comma separated list of day counts such as "18,80,256"; nullopt if any entry is invalid or the list is empty.
+ */
+optional<vector<unsigned long long>> ParseDays(string_view str)
+{
+    auto days = vector<unsigned long long>{};
+    while (!str.empty())
+    {
+        const auto kComma = min(str.find(','), str.size());
+        const auto kDay   = ParseDay(str.substr(0, kComma));
+        if (!kDay) { return nullopt; }
+        days.push_back(*kDay);
+        str.remove_prefix(min(kComma + 1, str.size()));
+    }
+    if (days.empty()) { return nullopt; }
+    return days;
 }
 
 int main(int argc, const char *args[])
 {
+    const auto kUsage = [&]{
+        cout << "usage: " << args[0] << " <input file> [days | --days d1,d2,...]" << endl;
+        return 1;
+    };
+    if (argc < 2 || argc > 4) { return kUsage(); }
     //Read data from file
-    cout << "data : " << endl;
-    auto initial_timers = readInput(args[1]);
-    
-    cout << "Part 1(After 80 days): " << CalculateFishCountAfter_N_Days(initial_timers, 80) << endl;
-    cout << "Part 1(After 256 days): " << CalculateFishCountAfter_N_Days(initial_timers, 256) << endl;
+    const auto kTimers = readInput(args[1]);
+    if (!kTimers)
+    {
+        cout << "invalid fish timer in " << args[1] << ", expected comma separated values 0-8" << endl;
+        return 1;
+    }
+    const auto &initial_timers = *kTimers;
+    if (argc > 2 && args[2] == string_view{"--days"})
+    {
+        const auto kDays = argc == 4 ? ParseDays(args[3]) : nullopt;
+        if (!kDays) { return kUsage(); }
+        PrintFishCounts(initial_timers, *kDays);
+        return 0;
+    }
+    if (argc == 4) { return kUsage(); }
+    if (argc == 3)
+    {
+        const auto kDays = ParseDay(args[2]);
+        if (!kDays) { return kUsage(); }
+        PrintFishCount(initial_timers, *kDays);
+        return 0;
+    }
+    cout << "Part 1(After 80 days): " << FishCountByMatrixPower<Exact128>(initial_timers, 80).ToString() << endl;
+    cout << "Part 2(After 256 days): " << FishCountByMatrixPower<Exact128>(initial_timers, 256).ToString() << endl;
     return 0;
-}
\ No newline at end of file
+}
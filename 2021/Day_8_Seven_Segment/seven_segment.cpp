@@ -2,8 +2,10 @@
  * @file seven_segment.cpp
  * @author Usama Tayyab (usamatayyab@gmail.com)
  * @brief 
- * Compilation command : g++ -std=c++17 ./seven_segment.cpp
+ * Compilation command : g++ -std=c++17 -O2 -pthread ./seven_segment.cpp
  * Compiled with gcc 9.4.0
+ * Usage: a.out input.txt
+ * The input file is memory mapped and decoded in newline aligned chunks, one per hardware thread.
  * This code is the solution of @link https://adventofcode.com/2021/day/8 @endlink
  * 
  * @copyright Copyright (c) 2024
@@ -13,245 +15,216 @@
 #include <string>
 #include <vector>
 #include <algorithm>
-#include <fstream>
-#include <sstream>
-#include <iterator>
 #include <array>
-#include <iomanip>
-#include <utility>
-#include <numeric>
-#include <unordered_map>
 #include <string_view>
-#include <bitset>
-#include <charconv>
+#include <cstdint>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-using std::ifstream;
 using std::cout;
-using std::string;
 using std::vector;
-using std::stringstream;
-using std::istream_iterator;
-using std::ostream_iterator;
 using std::array;
-using std::find;
 using std::cbegin;
 using std::cend;
 using std::size;
 using std::endl;
-using std::pair;
 using std::string_view;
-using std::bitset;
-using std::from_chars;
-
-void print(const auto &container, const char &delim = ' ')
-{
-    for (const auto &elem : container) { std::cout << elem << delim; }
-    std::cout << std::endl;
-}
 
 struct SignalsAndDigits
 {
-    array<string, 10> unique_signals;
-    array<string, 4> digits;
-    void print() const
+    array<uint8_t, 10> unique_signals;
+    array<uint8_t, 4> digits;
+    /**
+     * @brief 
+     * Parses "<10 signals> | <4 digits>" without allocating. Every word
+     * becomes a 7 bit mask, bit 0 for segment 'a' ... bit 6 for 'g', and
+     * the '|' is skipped.
+     */
+    static SignalsAndDigits fromString(string_view str)
     {
-        copy(cbegin(unique_signals), cend(unique_signals), ostream_iterator<string>{std::cout, " "});
-        std::cout << "| ";
-        copy(cbegin(digits), cend(digits), ostream_iterator<string>{std::cout, " "});
-        std::cout << std::endl;
-    }
-    static SignalsAndDigits fromString(const string &str)
-    {
-        auto ss      = stringstream{str};
-        auto signals = array<string, 10>{};
-        auto digits  = array<string, 4>{};
-        std::copy_n(istream_iterator<string>{ss}, size(signals), begin(signals));
-        //Reason for next is to skip | in input string
-        std::copy_n(std::next(istream_iterator<string>{ss}), size(digits), begin(digits));
-        return {signals, digits};
+        auto result = SignalsAndDigits{};
+        auto masks  = array<uint8_t, 14>{};
+        auto count  = size_t{0};
+        auto mask   = uint8_t{0};
+        for (const auto &ch : str)
+        {
+            if (ch >= 'a' && ch <= 'g') { mask |= static_cast<uint8_t>(1u << (ch - 'a')); }
+            else if (mask != 0)
+            {
+                if (count < size(masks)) { masks[count++] = mask; }
+                mask = 0;
+            }
+        }
+        if (mask != 0 && count < size(masks)) { masks[count++] = mask; }
+        std::copy_n(cbegin(masks), size(result.unique_signals), begin(result.unique_signals));
+        std::copy_n(cbegin(masks) + size(result.unique_signals), size(result.digits), begin(result.digits));
+        return result;
     }
 };
 
-vector<char> GetUnCommonElements(string s1, string s2)
+/**
+ * @brief 
+ * Builds a table from every signal mask of a display to the digit it shows.
+ * 1, 4, 7 and 8 are identified by their segment count. The remaining digits
+ * are told apart by how they overlap 1 and 4:
+ *   six segments : misses a segment of 1       -> 6
+ *                  contains all of 4           -> 9
+ *                  otherwise                   -> 0
+ *   five segments: contains all of 1           -> 3
+ *                  shares three segments with 4 -> 5
+ *                  otherwise                   -> 2
+ * Only the ten entries of this display are written; the digits shown on the
+ * right of '|' are always among them.
+ */
+array<int8_t, 128> MakeDecodeTable(const array<uint8_t, 10> &signals)
 {
-    std::sort(begin(s1), end(s1));
-    std::sort(begin(s2), end(s2));
-    // cout << "Calculating uncommon elements between " << std::quoted(s1) << " and " << std::quoted(s2) << endl;
-    auto uncommon_elements = vector<char>{};
-    std::set_symmetric_difference(
-        cbegin(s1), cend(s1),
-        cbegin(s2), cend(s2),
-        std::back_inserter(uncommon_elements));
-    // print(uncommon_elements);
-    return uncommon_elements;
+    auto one  = uint8_t{0};
+    auto four = uint8_t{0};
+    for (const auto &mask : signals)
+    {
+        const auto kSegments = __builtin_popcount(mask);
+        if (kSegments == 2) { one  = mask; }
+        if (kSegments == 4) { four = mask; }
+    }
+    auto table = array<int8_t, 128>{};
+    for (const auto &mask : signals)
+    {
+        const auto kSharedWithOne  = __builtin_popcount(mask & one);
+        const auto kSharedWithFour = __builtin_popcount(mask & four);
+        auto digit = int8_t{0};
+        switch (__builtin_popcount(mask))
+        {
+            case 2: digit = 1; break;
+            case 3: digit = 7; break;
+            case 4: digit = 4; break;
+            case 7: digit = 8; break;
+            case 6: digit = (kSharedWithOne == 1) ? 6 : (kSharedWithFour == 4) ? 9 : 0; break;
+            case 5: digit = (kSharedWithOne == 2) ? 3 : (kSharedWithFour == 3) ? 5 : 2; break;
+        }
+        table[mask] = digit;
+    }
+    return table;
 }
 
-pair<char, char> GetUpperBottomRightFromSixAndOne(const string &one, const string &six)
+int DigitsToInt(const array<int8_t, 128> &decode_table, const array<uint8_t, 4> &encoded_digits)
 {
-    auto upper_rt  = '\0';
-    auto bottom_rt = '\0';
-    auto pos1      = six.find(one[0]);
-    if (pos1 == string::npos) { upper_rt = one[0]; bottom_rt = one[1]; }
-    else                      { upper_rt = one[1]; bottom_rt = one[0]; }
-    return {upper_rt, bottom_rt};
+    auto i = 0;
+    for (const auto &mask : encoded_digits) { i = i * 10 + decode_table[mask]; }
+    return i;
 }
 
-struct SegmentTemplate
+/**
+ * @brief Read-only memory mapping of a whole file.
+ */
+class MappedFile
 {
-    char upper;
-    char upper_lt;
-    char upper_rt;
-    char mid;
-    char bottom_lt;
-    char bottom_rt;
-    char bottom;
-    void print() const
+    public:
+    MappedFile(const char *filename)
+    {
+        const auto fd = open(filename, O_RDONLY);
+        if (fd < 0) { return; }
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            if (auto *ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0); ptr != MAP_FAILED)
+            {
+                addr   = static_cast<const char *>(ptr);
+                length = static_cast<size_t>(st.st_size);
+            }
+        }
+        close(fd);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile()
     {
-        cout
-        << "upper:     " << upper     << endl
-        << "upper_lt:  " << upper_lt  << endl
-        << "upper_rt:  " << upper_rt  << endl
-        << "mid:       " << mid       << endl
-        << "bottom_lt: " << bottom_lt << endl
-        << "bottom_rt: " << bottom_rt << endl
-        << "bottom:    " << bottom    << endl;
+        if (addr != nullptr) { munmap(const_cast<char *>(addr), length); }
     }
+    string_view View() const { return {addr, length}; }
+
+    private:
+    const char *addr{nullptr};
+    size_t length{0};
 };
 
-SegmentTemplate MakeTemplateFromSignals(const array<string, 10> &signals)
+struct DecodeTotals
 {
-    // cout << "Processing signals...\n";
-    // print(signals);
-    //Find the signal represented by 1. 1 can represented by using only two segments.
-    const auto &one   = *find_if(cbegin(signals), cend(signals), [](const string &str) { return size(str) == 2; });
-    //Find the signal represented by 7. 7 can represented by using only three segments.
-    const auto &seven = *find_if(cbegin(signals), cend(signals), [](const string &str) { return size(str) == 3; });
-    //Find the signal represented by 4. 4 can represented by using onyl four segments.
-    const auto &four  = *find_if(cbegin(signals), cend(signals), [](const string &str) { return size(str) == 4; });
-    // cout << "one : "   << one   << endl;
-    // cout << "seven : " << seven << endl;
-    // cout << "four : "  << four  << endl;
-    
-    const auto upper  = GetUnCommonElements(one, seven).front();
-    // cout << "upper segment: " << upper << endl;
-    //possible_ult_mid will contain two values. These two value belong to upper-left and mid segment.
-    const auto possible_upperlt_mid = GetUnCommonElements(one, four);
-    // cout << "possible values for upper-left and mid:" << endl;  print(possible_upperlt_mid); 
-    
-    //Only 0, 6 and 9 uses six length segments.
-    auto all_six_length_signals = vector<string>(3);
-    copy_if(cbegin(signals), cend(signals), begin(all_six_length_signals), [](const auto &signal) { return size(signal) == 6; });
-    // cout << "all signals with 6 lenght: "; print(all_six_length_signals);
+    long long easy_digits{0};//Part 1: how many output digits are 1, 4, 7 or 8
+    long long sum{0};        //Part 2: sum of all decoded output values
+    DecodeTotals &operator+=(const DecodeTotals &other)
+    {
+        easy_digits += other.easy_digits;
+        sum         += other.sum;
+        return *this;
+    }
+};
 
-    auto six_pos = find_if(cbegin(all_six_length_signals), cend(all_six_length_signals), [&one](const auto &signal){
-        auto pos1 = signal.find(one[0]);
-        auto pos2 = signal.find(one[1]);
-        return !((pos1 != string::npos) && (pos2 != string::npos));
-    });
-    const auto six = *six_pos;
-    // cout << "six : "  << six  << endl;
-    all_six_length_signals.erase(six_pos);
-    const auto [upper_rt, bottom_rt] = GetUpperBottomRightFromSixAndOne(one, six);
-    // cout << "upper-rt segment:  " << upper_rt  << endl;
-    // cout << "bottom-rt segment: " << bottom_rt << endl;
+DecodeTotals DecodeChunk(string_view chunk)
+{
+    auto totals = DecodeTotals{};
+    while (!chunk.empty())
+    {
+        const auto kEol  = std::min(chunk.find('\n'), chunk.size());
+        const auto kLine = chunk.substr(0, kEol);
+        chunk.remove_prefix(std::min(kEol + 1, chunk.size()));
+        if (kLine.find('|') == string_view::npos) { continue; }//blank or malformed line
 
-    // cout << "0 and 9 signals: "; print(all_six_length_signals);
-    //uncommon values among 0 and 9 segments will give info about mid and bottom-left
-    //After that we can compute upper-left and bottom too
-    auto uncommon_elems = GetUnCommonElements(all_six_length_signals[0], all_six_length_signals[1]);
-    // print(uncommon_elems);
-    const auto [upper_lt, mid, bottom_lt] = [&uncommon_elems, &possible_upperlt_mid](){
-        auto upper_lt  = '\0';
-        auto mid       = '\0';
-        auto bottom_lt = '\0';
-        auto pos = find(cbegin(uncommon_elems), cend(uncommon_elems), possible_upperlt_mid[0]);
-        if (pos != cend(uncommon_elems))
-        {
-            mid      = possible_upperlt_mid[0];
-            upper_lt = possible_upperlt_mid[1];
-        }
-        else
+        const auto signal_and_digits = SignalsAndDigits::fromString(kLine);
+        const auto decode_table      = MakeDecodeTable(signal_and_digits.unique_signals);
+        for (const auto &mask : signal_and_digits.digits)
         {
-            mid      = possible_upperlt_mid[1];
-            upper_lt = possible_upperlt_mid[0];
-            pos      = find(cbegin(uncommon_elems), cend(uncommon_elems), possible_upperlt_mid[1]);
+            const auto kDigit = decode_table[mask];
+            totals.easy_digits += (kDigit == 1 || kDigit == 4 || kDigit == 7 || kDigit == 8);
         }
-        // cout << "remaining element: " << *pos << endl;
-        uncommon_elems.erase(pos);
-        // print(uncommon_elems);
-        bottom_lt = uncommon_elems.front();
-        return std::make_tuple(upper_lt, mid, bottom_lt);
-    }();
-    // cout << "upper-left: "  << upper_lt  << endl;
-    // cout << "mid: "         << mid       << endl;
-    // cout << "bottom-left: " << bottom_lt << endl;
-    
-    //Now all segments are computed except bottom, which can be caluclated
-    //by finding the missing char
-    const auto &eight  = *find_if(cbegin(signals), cend(signals), [](const string &str) { return size(str) == 7; });
-    const char bottom = std::accumulate(cbegin(eight), cend(eight), 0) - (upper + upper_rt + upper_lt + bottom_rt + mid + bottom_lt);
-    // cout << "bottom: " << bottom << endl;
-    return {upper, upper_lt, upper_rt, mid, bottom_lt, bottom_rt, bottom};
+        totals.sum += DigitsToInt(decode_table, signal_and_digits.digits);
+    }
+    return totals;
 }
 
-char CalculateDigit(const SegmentTemplate &seg_template, const string &digits)
+/**
+ * @brief 
+ * Splits @arg data into {thread_count} chunks that each end on a newline,
+ * decodes every chunk on its own thread and adds up the partial results.
+ */
+DecodeTotals DecodeParallel(string_view data, unsigned thread_count)
 {
-    // cout << "digits: " << digits << endl;
-    // seg_template.print();
-    auto sz = size(digits);
-    if      (sz == 2) { return '1'; }
-    else if (sz == 4) { return '4'; }
-    else if (sz == 3) { return '7'; }
-    else if (sz == 7) { return '8'; }
-    else
+    thread_count = std::max(1u, thread_count);
+    auto bounds  = vector<size_t>{0};
+    for (auto idx = 1u; idx < thread_count; ++idx)
     {
-        static const auto template_map = std::unordered_map<std::bitset<7>, char> ({
-            {bitset<7>("1110111"), '0'},
-            {bitset<7>("1011101"), '2'},
-            {bitset<7>("1011011"), '3'},
-            {bitset<7>("1101011"), '5'},
-            {bitset<7>("1101111"), '6'},
-            {bitset<7>("1111011"), '9'}
-        });
-        auto str = string{};
-        auto bs = bitset<7>{};
-        for (const auto &d : digits)
-        {
-            if (d == seg_template.upper)     { bs[6] = 1; }
-            if (d == seg_template.upper_lt)  { bs[5] = 1; }
-            if (d == seg_template.upper_rt)  { bs[4] = 1; }
-            if (d == seg_template.mid)       { bs[3] = 1; }
-            if (d == seg_template.bottom_lt) { bs[2] = 1; }
-            if (d == seg_template.bottom_rt) { bs[1] = 1; }
-            if (d == seg_template.bottom)    { bs[0] = 1; }
-        }
-        // cout << bs << endl;
-        return template_map.at(bs);
+        auto pos = std::max(bounds.back(), data.size() * idx / thread_count);
+        pos      = std::min(data.find('\n', pos), data.size());
+        bounds.push_back(std::min(pos + 1, data.size()));
     }
-}
+    bounds.push_back(data.size());
 
-int DigitsToInt(const SegmentTemplate &seg_template, const array<string, 4> &encoded_digits)
-{
-    auto digits = std::array<char, encoded_digits.size()>{};
-    std:transform(cbegin(encoded_digits), cend(encoded_digits), begin(digits), [&seg_template](const auto &str){ return CalculateDigit(seg_template, str); });
-    auto i = 0;
-    from_chars(data(digits), data(digits) + size(digits), i);
-    return i;
+    auto partials = vector<DecodeTotals>(thread_count);
+    auto workers  = vector<std::thread>{};
+    for (auto idx = 1u; idx < thread_count; ++idx)
+    {
+        workers.emplace_back([&, idx](){ partials[idx] = DecodeChunk(data.substr(bounds[idx], bounds[idx + 1] - bounds[idx])); });
+    }
+    partials[0] = DecodeChunk(data.substr(bounds[0], bounds[1] - bounds[0]));
+    for (auto &worker : workers) { worker.join(); }
+
+    auto totals = DecodeTotals{};
+    for (const auto &partial : partials) { totals += partial; }
+    return totals;
 }
 
 int main(int argc, const char *args[])
 {
-    auto fin = std::ifstream{args[1]};
-    auto temp_str = std::string{};
-    auto vec = vector<int>{};
-    while (getline(fin, temp_str))
+    if (argc < 2)
     {
-        const auto signal_and_digits = SignalsAndDigits::fromString(temp_str);
-        auto segment_template = MakeTemplateFromSignals(signal_and_digits.unique_signals);
-        auto num = DigitsToInt(segment_template, signal_and_digits.digits);
-        vec.push_back(num);
-        // cout << "num: " << num << endl;
+        cout << "usage: " << args[0] << " <input file>" << endl;
+        return 1;
     }
-    cout << "TOTAL SUM = " << std::accumulate(cbegin(vec), cend(vec), 0);
+    const auto kFile   = MappedFile{args[1]};
+    const auto kTotals = DecodeParallel(kFile.View(), std::thread::hardware_concurrency());
+    cout << "Part 1 : " << kTotals.easy_digits << endl;
+    cout << "TOTAL SUM = " << kTotals.sum << endl;
     return 0;
-}
\ No newline at end of file
+}
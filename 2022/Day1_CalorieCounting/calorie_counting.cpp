@@ -2,31 +2,297 @@
 #include <algorithm>
 #include <iostream>
 #include <fstream>
-#include <algorithm>
 #include <iterator>
 #include <vector>
-#include <tuple>
+#include <queue>
+#include <numeric>
+#include <functional>
+#include <string_view>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <optional>
+#include <charconv>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
+/**
+ * @brief Keeps the K largest values seen so far in a min-heap of size K,
+ * so each push costs O(log K) and memory stays O(K).
+ */
+class TopK
+{
+    public:
+    explicit TopK(size_t k) : kK{ k } { }
+
+    void Push(long long value)
+    {
+        if (0 == kK) { return; }
+        if (size(heap) < kK)         { heap.push(value); }
+        else if (value > heap.top()) { heap.pop(); heap.push(value); }
+    }
+
+    /**
+     * @brief Returns the kept values, largest first
+     */
+    vector<long long> Sorted() const
+    {
+        auto copy   = heap;
+        auto values = vector<long long>{};
+        for (; !copy.empty(); copy.pop()) { values.push_back(copy.top()); }
+        reverse(begin(values), end(values));
+        return values;
+    }
+
+    private:
+    const size_t kK;
+    priority_queue<long long, vector<long long>, greater<long long>> heap;
+};
+
+enum class LineKind
+{
+    kBlank,
+    kNumber,
+    kInvalid
+};
+
+/**
+ * @brief Classifies one line (without its '\n') and stores its value in {value}.
+ * A trailing '\r' is ignored, so CRLF files parse like LF files. Any other
+ * non digit character, or more digits than a long long can hold, makes the
+ * line invalid. Digits are accumulated with a select instead of a branch on
+ * the character.
+ */
+inline LineKind ParseLine(const char *first, const char *last, long long &value)
+{
+    if (first != last && '\r' == last[-1]) { --last; }
+    if (first == last)                     { return LineKind::kBlank; }
+    auto number = 0ll;
+    auto bad    = (last - first) > 18;
+    for (; first != last; ++first)
+    {
+        const auto kDigit   = static_cast<unsigned char>(*first - '0');
+        const auto kIsDigit = kDigit < 10;
+        number = kIsDigit ? number * 10 + kDigit : number;
+        bad   |= !kIsDigit;
+    }
+    value = number;
+    return bad ? LineKind::kInvalid : LineKind::kNumber;
+}
+
+/**
+ * @brief Turns lines into group sums, the one rule shared by both parsers:
+ * numbers are added to the current group, a blank line closes it and the
+ * last group is closed by Finish() even without a trailing blank line.
+ * @throws invalid_argument on a line that is neither a number nor blank
+ */
+template<class Func>
+class GroupSplitter
+{
+    public:
+    explicit GroupSplitter(Func on_group) : on_group{ on_group } { }
+
+    void AddLine(const char *first, const char *last)
+    {
+        auto value = 0ll;
+        switch (ParseLine(first, last, value))
+        {
+            case LineKind::kNumber : { sum += value; group_open = true; break; }
+            case LineKind::kBlank  : { Finish(); break; }
+            case LineKind::kInvalid: { throw invalid_argument{ "not a calorie count: " + string{ first, last } }; }
+        }
+    }
+
+    void Finish()
+    {
+        if (group_open) { on_group(sum); }
+        sum        = 0;
+        group_open = false;
+    }
+
+    private:
+    Func on_group;
+    long long sum{ 0 };
+    bool group_open{ false };
+};
+
+/**
+ * @brief Streams the inventory line by line and pushes each group sum into {top} as soon as it ends.
+ */
+void AggregateGroups(istream &in, TopK &top)
+{
+    auto splitter = GroupSplitter{ [&top](long long sum){ top.Push(sum); } };
+    for (auto str = string{}; getline(in, str);) { splitter.AddLine(str.data(), str.data() + size(str)); }
+    splitter.Finish();
+}
+
+/**
+ * @brief Calls {on_group} with the sum of every blank-line separated group in {buffer}.
+ * Line boundaries are found with memchr, which libc implements with vector
+ * instructions; lines are split into groups exactly as by AggregateGroups().
+ */
+template<class Func>
+void ForEachGroupSum(string_view buffer, Func on_group)
+{
+    auto pos        = buffer.data();
+    const auto kEnd = pos + size(buffer);
+    auto splitter   = GroupSplitter{ on_group };
+    while (pos < kEnd)
+    {
+        const auto kNewline = static_cast<const char *>(memchr(pos, '\n', kEnd - pos));
+        const auto kLineEnd = kNewline ? kNewline : kEnd;
+        splitter.AddLine(pos, kLineEnd);
+        pos = kLineEnd + 1;
+    }
+    splitter.Finish();
+}
+
+/**
+ * @brief Read-only memory mapping of a whole file; View() is empty if the file
+ * cannot be mapped (missing, empty or not a regular file).
+ */
+class MappedFile
+{
+    public:
+    MappedFile(const char *filename)
+    {
+        const auto fd = open(filename, O_RDONLY);
+        if (fd < 0) { return; }
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            if (auto *ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0); ptr != MAP_FAILED)
+            {
+                addr   = static_cast<const char *>(ptr);
+                length = static_cast<size_t>(st.st_size);
+                madvise(ptr, length, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile()
+    {
+        if (addr != nullptr) { munmap(const_cast<char *>(addr), length); }
+    }
+    string_view View() const { return {addr, length}; }
+
+    private:
+    const char *addr{nullptr};
+    size_t length{0};
+};
+
+/**
+ * @brief Generates about {megabytes} MB of random inventory and reports the throughput
+ * of the mapped-buffer scanner and of the getline stream parser.
+ */
+void RunParserBenchmark(size_t megabytes)
+{
+    auto rng      = mt19937{ 7 };
+    auto calories = uniform_int_distribution<int>{ 1000, 69999 };
+    auto items    = uniform_int_distribution<int>{ 1, 15 };
+    auto data     = string{};
+    data.reserve(megabytes << 20);
+    while (size(data) < (megabytes << 20))
+    {
+        for (auto item = items(rng); item > 0; --item) { data += to_string(calories(rng)); data += '\n'; }
+        data += '\n';
+    }
+    using Clock = chrono::steady_clock;
+    const auto kMBps = [&](Clock::duration d){ return size(data) / 1048576.0 / chrono::duration<double>(d).count(); };
+
+    auto start      = Clock::now();
+    auto scan_total = 0ll;
+    auto scan_top   = TopK{ 3 };
+    ForEachGroupSum(data, [&](long long sum){ scan_total += sum; scan_top.Push(sum); });
+    const auto kScanTime = Clock::now() - start;
+
+    start = Clock::now();
+    auto stream     = istringstream{ data };
+    auto stream_top = TopK{ 3 };
+    AggregateGroups(stream, stream_top);
+    const auto kStreamTime = Clock::now() - start;
+
+    cout << size(data) / 1048576.0 << " MB, checksum " << scan_total << ", top " << scan_top.Sorted()[0] << " / " << stream_top.Sorted()[0] << "\n";
+    cout << "buffer scan     : " << kMBps(kScanTime) << " MB/s\n";
+    cout << "getline         : " << kMBps(kStreamTime) << " MB/s\n";
+}
+
+/**
+ * @brief Parses a whole argument as an unsigned count; nullopt if it is not one.
+ */
+optional<size_t> ParseCount(string_view str)
+{
+    auto count = size_t{ 0 };
+    const auto [ptr, ec] = from_chars(str.data(), str.data() + size(str), count);
+    if (ec != errc{} || ptr != str.data() + size(str) || str.empty()) { return nullopt; }
+    return count;
+}
+
 int main(int argc, const char *args[])
 {
-    auto vec = vector<int>{};
-    for (auto [str, fin, sum] = tuple{ string{ "" }, ifstream{ args[1] }, int{ 0 } }; fin ;)
+    const auto kUsage = [&]{
+        cout << "usage: " << args[0] << " <input file> [K] [--debug] | --bench [MB]\n";
+        return 1;
+    };
+    if (argc < 2) { return kUsage(); }
+    if (string_view{ args[1] } == "--bench")
+    {
+        const auto kMegabytes = argc > 2 ? ParseCount(args[2]) : optional{ size_t{ 256 } };
+        if (!kMegabytes) { return kUsage(); }
+        RunParserBenchmark(*kMegabytes);
+        return 0;
+    }
+    auto k     = size_t{ 3 };
+    auto debug = false;
+    for (auto idx = 2; idx < argc; ++idx)
+    {
+        if (string_view{ args[idx] } == "--debug") { debug = true; continue; }
+        const auto kK = ParseCount(args[idx]);
+        if (!kK) { return kUsage(); }
+        k = *kK;
+    }
+    auto top         = TopK{ std::max(k, size_t{ 1 }) };
+    const auto kFile = MappedFile{ args[1] };
+    try
+    {
+        if (!kFile.View().empty())
+        {
+            ForEachGroupSum(kFile.View(), [&top](long long sum){ top.Push(sum); });
+        }
+        else
+        {
+            auto fin = ifstream{ args[1] };//not mappable, e.g. a pipe
+            AggregateGroups(fin, top);
+        }
+    }
+    catch (const invalid_argument &error)
+    {
+        cout << error.what() << "\n";
+        return 1;
+    }
+    const auto kTop = top.Sorted();
+    if (kTop.empty())
     {
-        getline(fin, str);
-        if (str.empty()) { vec.push_back(sum); sum = 0; }
-        else             { sum += stoi(str);            }
+        cout << "No elves in input\n";
+        return 1;
     }
-    sort(begin(vec),end(vec), std::greater{});
-    for (const auto &s : vec) { cout << s << endl; }
+    if (debug) { for (const auto &s : kTop) { cout << s << endl; } }
 
     {
-        cout << "Part 1, Elf with most calories : " << vec[0] << endl;
+        cout << "Part 1, Elf with most calories : " << kTop[0] << endl;
     }
     {
-        cout << "Part 2, sum of top three calories: " << vec[0] + vec[1] + vec[2] << endl;
+        cout << "Part 2, sum of top " << size(kTop) << " calories: " << accumulate(cbegin(kTop), cend(kTop), 0ll) << endl;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -2,136 +2,232 @@
 #include <string>
 #include <fstream>
 #include <algorithm>
-#include <unordered_map>
+#include <array>
 #include <vector>
 #include <utility>
+#include <optional>
+#include <string_view>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
-bool IsRock(const char &ch)
-{
-    return 'A' == ch || 'X' == ch;
-}
-
-bool IsPaper(const char &ch)
-{
-    return 'B' == ch || 'Y' == ch;
-}
-
-bool IsScissor(const char &ch)
-{
-    return 'C' == ch || 'Z' == ch;
-}
-
-enum class Shapes
+enum Shapes : int
 {
     kRock,
     kPaper,
     kScissor
 };
 
-enum class GameResult
+enum GameResult : int
 {
-    kWin,
+    kLose,
     kDraw,
-    kLose
+    kWin
 };
 
-GameResult GetSingleMoveResult(const char &ch1, const char &ch2)
+constexpr int ShapeScore(int shape)          { return shape + 1; }
+constexpr int OutcomeScore(int game_result)  { return 3 * game_result; }
+
+/**
+ * @brief Result for {my_move} against {opponent_move}: each shape beats the one before it (cyclically).
+ */
+constexpr int GetSingleMoveResult(int opponent_move, int my_move)
+{
+    return (my_move - opponent_move + 4) % 3;
+}
+
+/**
+ * @brief Shape to play against {opponent_move} to get {game_result}.
+ */
+constexpr int MoveForRoundTo(int opponent_move, int game_result)
 {
-    if (IsRock(ch1))
+    return (opponent_move + game_result + 2) % 3;
+}
+
+static_assert(GetSingleMoveResult(kRock, kPaper) == kWin && GetSingleMoveResult(kScissor, kPaper) == kLose);
+static_assert(GetSingleMoveResult(kScissor, kRock) == kWin && GetSingleMoveResult(kPaper, kPaper) == kDraw);
+static_assert(MoveForRoundTo(kRock, kLose) == kScissor && MoveForRoundTo(kScissor, kWin) == kRock);
+
+/**
+ * @brief Score of every possible round, indexed by 3 * (opponent column) + (my column).
+ * Part 1 reads my column as a shape, Part 2 as the needed result.
+ * Both scores are packed in one entry: Part 1 in the low 32 bits, Part 2 in the high 32 bits,
+ * so one lookup and one add score a round for both parts.
+ */
+constexpr auto kRoundScores = []{
+    auto table = array<uint64_t, 9>{};
+    for (auto opponent = 0; opponent < 3; ++opponent)
     {
-        if      (IsRock(ch2) ) { return GameResult::kDraw;  }
-        else if (IsPaper(ch2)) { return GameResult::kWin;   } // ch2 wins
-        else if (IsScissor(ch2)) { return GameResult::kLose; }
+        for (auto column = 0; column < 3; ++column)
+        {
+            const auto kPart1 = ShapeScore(column) + OutcomeScore(GetSingleMoveResult(opponent, column));
+            const auto kPart2 = ShapeScore(MoveForRoundTo(opponent, column)) + OutcomeScore(column);
+            table[3 * opponent + column] = uint64_t(kPart1) | (uint64_t(kPart2) << 32);
+        }
     }
-    else if (IsPaper(ch1))
+    return table;
+}();
+
+struct TotalScores
+{
+    uint64_t part1{ 0 };
+    uint64_t part2{ 0 };
+};
+
+/**
+ * @brief Scores a log made only of 4-byte records "A X\n" (the last newline may be missing).
+ * Each record is loaded as one 32-bit little-endian word, checked with masks and
+ * looked up in kRoundScores; the loop has no data-dependent branches. Rounds are summed
+ * in blocks small enough that the packed Part 1 field cannot carry into Part 2.
+ * @return nullopt if the log is not in that exact format
+ */
+optional<TotalScores> ScorePackedRecords(string_view log)
+{
+    auto padded = string{};
+    if (3 == size(log) % 4)
     {
-        if (IsRock(ch2))        { return GameResult::kLose; }
-        else if (IsPaper(ch2))   { return GameResult::kDraw; }
-        else if (IsScissor(ch2)) { return GameResult::kWin;  }
+        padded.assign(log.substr(size(log) - 3));
+        padded.push_back('\n');
     }
-    else if (IsScissor(ch1))
+    else if (0 != size(log) % 4) { return nullopt; }
+    const auto ScoreRange = [](const char *data, size_t record_count, TotalScores &totals) {
+        constexpr auto kBlockSize = size_t{ 1 } << 24;//9 * 2^24 fits in 32 bits
+        auto bad = uint32_t{ 0 };
+        for (auto block_begin = size_t{ 0 }; block_begin < record_count; block_begin += kBlockSize)
+        {
+            const auto kBlockEnd = std::min(record_count, block_begin + kBlockSize);
+            auto packed = uint64_t{ 0 };
+            for (auto record = block_begin; record < kBlockEnd; ++record)
+            {
+                const auto kBytes = reinterpret_cast<const unsigned char *>(data + 4 * record);
+                const auto kWord  = uint32_t(kBytes[0]) | uint32_t(kBytes[1]) << 8 | uint32_t(kBytes[2]) << 16 | uint32_t(kBytes[3]) << 24;
+                const auto kOpponent = (kWord & 0xFF) - 'A';
+                const auto kColumn   = ((kWord >> 16) & 0xFF) - 'X';
+                const auto kBad      = (kOpponent > 2) | (kColumn > 2) | ((kWord & 0xFF00FF00) != 0x0A002000);
+                bad    |= kBad;
+                packed += kRoundScores[kBad ? 0 : 3 * kOpponent + kColumn];
+            }
+            totals.part1 += packed & 0xFFFFFFFF;
+            totals.part2 += packed >> 32;
+        }
+        return 0 == bad;
+    };
+    auto totals = TotalScores{};
+    if (!ScoreRange(log.data(), size(log) / 4, totals))              { return nullopt; }
+    if (!padded.empty() && !ScoreRange(padded.data(), 1, totals))    { return nullopt; }
+    return totals;
+}
+
+/**
+ * @brief Scores a log of whitespace separated move pairs in any layout, e.g. with "\r\n" line endings.
+ * @throws invalid_argument on a letter outside A-C / X-Z
+ */
+TotalScores ScoreTokens(istream &in)
+{
+    auto totals = TotalScores{};
+    for (auto [opponent_move, my_move] = pair{ '\0', '\0' }; in >> opponent_move >> my_move ;)
     {
-        if      (IsRock(ch2)) { return GameResult::kWin;    }
-        else if (IsPaper(ch2)) { return GameResult::kLose;   }
-        else if (IsScissor(ch2)) { return GameResult::kDraw; }
+        const auto kOpponent = static_cast<unsigned>(opponent_move - 'A');
+        const auto kColumn   = static_cast<unsigned>(my_move - 'X');
+        if (kOpponent > 2 || kColumn > 2) { throw invalid_argument{ string{ "invalid round: " } + opponent_move + ' ' + my_move }; }
+        const auto kScores = kRoundScores[3 * kOpponent + kColumn];
+        totals.part1 += kScores & 0xFFFFFFFF;
+        totals.part2 += kScores >> 32;
     }
+    return totals;
 }
 
-Shapes MoveForRoundTo(const char &oponent_move, const GameResult &game_result)
+/**
+ * @brief Read-only memory mapping of a whole file; View() is empty if the file
+ * cannot be mapped (missing, empty or not a regular file).
+ */
+class MappedFile
 {
-    switch (game_result)
+    public:
+    MappedFile(const char *filename)
     {
-        case GameResult::kWin : {
-            if (IsRock(oponent_move))           { return Shapes::kPaper;    }
-            else if (IsPaper(oponent_move))     { return Shapes::kScissor;  }
-            else if (IsScissor(oponent_move))   { return Shapes::kRock;     }
-            break;
-        }
-        case GameResult::kDraw:
-        {
-            if (IsRock(oponent_move))           { return Shapes::kRock;     }
-            else if (IsPaper(oponent_move))     { return Shapes::kPaper;    }
-            else if (IsScissor(oponent_move))   { return Shapes::kScissor;  }
-            break;
-        }
-        case GameResult::kLose :
+        const auto fd = open(filename, O_RDONLY);
+        if (fd < 0) { return; }
+        struct stat st{};
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
         {
-            if (IsRock(oponent_move))           { return Shapes::kScissor;  }
-            else if (IsPaper(oponent_move))     { return Shapes::kRock;     }
-            else if (IsScissor(oponent_move))   { return Shapes::kPaper;    }
-            break;
+            if (auto *ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0); ptr != MAP_FAILED)
+            {
+                addr   = static_cast<const char *>(ptr);
+                length = static_cast<size_t>(st.st_size);
+            }
         }
+        close(fd);
     }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile()
+    {
+        if (addr != nullptr) { munmap(const_cast<char *>(addr), length); }
+    }
+    string_view View() const { return {addr, length}; }
+
+    private:
+    const char *addr{nullptr};
+    size_t length{0};
+};
+
+/**
+ * @brief Generates about {megabytes} MB of random rounds and reports the throughput of the packed scorer.
+ */
+void RunBenchmark(size_t megabytes)
+{
+    auto rng    = mt19937{ 2022 };
+    auto letter = uniform_int_distribution<int>{ 0, 2 };
+    auto log    = string{};
+    log.reserve(megabytes << 20);
+    while (size(log) < (megabytes << 20))
+    {
+        log += char('A' + letter(rng)); log += ' '; log += char('X' + letter(rng)); log += '\n';
+    }
+    const auto kStart  = chrono::steady_clock::now();
+    const auto kTotals = ScorePackedRecords(log).value();
+    const auto kSeconds = chrono::duration<double>(chrono::steady_clock::now() - kStart).count();
+    cout << size(log) / 4 << " rounds, Part 1: " << kTotals.part1 << ", Part 2: " << kTotals.part2 << "\n";
+    cout << "packed scorer: " << size(log) / 1e9 / kSeconds << " GB/s\n";
 }
 
 int main(int argc, const char *args[])
 {
-    const auto kCharToShapeUmap   = unordered_map<char, Shapes>{
-        { 'X', Shapes::kRock },
-        { 'Y', Shapes::kPaper },
-        { 'Z', Shapes::kScissor }
-    };
-    const auto kShapeScoreUmap   = unordered_map<Shapes, int>{
-        { Shapes::kRock, 1 },
-        { Shapes::kPaper, 2 },
-        { Shapes::kScissor, 3 }
-    }; 
-    const auto kOutcomeScoreUmap = unordered_map<GameResult, int>{
-        { GameResult::kLose, 0 },
-        { GameResult::kDraw, 3 },
-        { GameResult::kWin, 6 }
-    };
-    auto moves = vector<pair<char, char>>{};
-    
-    for (auto [fin, opponent_move, my_move] = tuple{ ifstream{ args[1] }, '\0', '\0'}; fin >> opponent_move >> my_move ;)
+    if (argc < 2)
     {
-        moves.push_back({ opponent_move, my_move });
+        cout << "usage: " << args[0] << " <input file> | --bench [MB]\n";
+        return 1;
     }
-
+    if (string_view{ args[1] } == "--bench")
     {
-        auto total_score = 0;
-        for (const auto &[oponent_move, my_move] : moves)
-        {
-            // cout << oponent_move << ' ' << my_move << endl;
-            total_score += kShapeScoreUmap.at(kCharToShapeUmap.at(my_move)) + kOutcomeScoreUmap.at(GetSingleMoveResult(oponent_move, my_move));
-        }
-        cout << "Part 1: " << total_score << endl;
+        RunBenchmark(argc > 2 ? stoul(args[2]) : 256);
+        return 0;
     }
-
+    const auto kFile = MappedFile{ args[1] };
+    auto totals      = ScorePackedRecords(kFile.View());
+    if (!totals.has_value() || kFile.View().empty())
     {
-        const auto kNeededOutcomeUmap = unordered_map<char, GameResult>{ { 'X', GameResult::kLose }, { 'Y', GameResult::kDraw }, { 'Z', GameResult::kWin } };
-        auto total_score2 = 0;
-        for (const auto &[kOponentMove, kNeededGameResult] : moves)
+        auto fin = ifstream{ args[1] };
+        try
+        {
+            totals = ScoreTokens(fin);
+        }
+        catch (const invalid_argument &error)
         {
-            const auto &kNeededOutcome = kNeededOutcomeUmap.at(kNeededGameResult);
-            const auto kNeededMove = MoveForRoundTo(kOponentMove, kNeededOutcome);
-            total_score2 += kOutcomeScoreUmap.at(kNeededOutcome) + kShapeScoreUmap.at(kNeededMove);
+            cout << error.what() << "\n";
+            return 1;
         }
-        cout << total_score2 << endl;
     }
-
+    cout << "Part 1: " << totals->part1 << endl;
+    cout << "Part 2: " << totals->part2 << endl;
 
     return 0;
-}
\ No newline at end of file
+}